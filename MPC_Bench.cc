@@ -0,0 +1,311 @@
+//------------------------------------------------------------------------
+// Micro-benchmarks of the MPC_PolyModule arithmetic and of
+// Peer::LagrangeInterpolate(), built by "make bench" as mpcBench.
+//
+// Each benchmark is calibrated to run at least BENCH_BATCH_MS per
+// batch, then timed over BENCH_REPEATS batches.  The median ns/op
+// of the batches is reported, with the fastest and slowest, so
+// one noisy batch does not move the result.
+//
+//   mpcBench [-f filter] [-j file.json]
+//     -f  run only the benchmarks whose name contains filter
+//     -j  also write the results as JSON, for regression tracking
+//
+// The objects are compiled with the CFLAGS of netPeer, so this
+// measures the code netPeer runs.
+//------------------------------------------------------------------------
+
+#include "MPC_Peer.h"
+
+#include <unistd.h>     // getopt
+
+#include <random>
+#include <fstream>
+#include <iomanip>
+
+#define BENCH_BATCH_MS 20    // Shortest timed batch
+#define BENCH_REPEATS  7     // Timed batches per benchmark
+#define BENCH_INPUTS   256   // Distinct inputs cycled through
+
+//------------------------------------------------------------
+// Prime fields measured: the small prime of the config files, a
+// generic 30 bit prime, the two Mersenne primes with their own
+// reduction, and a generic prime near the 2^63 limit
+//------------------------------------------------------------
+struct BenchPrime {
+    string name;
+    int64  prime;
+};
+
+static const BenchPrime benchPrimes[] = {
+    { "101",     101LL                 },
+    { "1e9+7",   1000000007LL          },
+    { "2^31-1",  2147483647LL          },
+    { "2^61-1",  2305843009213693951LL },
+    { "2^62-57", 4611686018427387847LL },
+};
+
+//------------------------------------------------------------
+// Result of one benchmark
+//------------------------------------------------------------
+struct BenchResult {
+    string name;
+    string params;      // e.g. "degree=8 prime=2^61-1"
+    uint64 iterations;  // Per batch
+    double nsPerOp;     // Median of the batches
+    double minNs;
+    double maxNs;
+};
+
+// Every result is added here, so the work cannot be optimized away
+static volatile int64 benchSink;
+
+//------------------------------------------------------------
+// Time op( i ) for i = 0 .. iterations - 1, in ns
+//------------------------------------------------------------
+template< typename Op >
+static uint64 TimeBatch( Op &op, uint64 iterations ) {
+
+    int64  sum   = 0;
+    uint64 start = MetricsNow();
+    for ( uint64 i = 0; i < iterations; i++ ) {
+        sum += op( i );
+    }
+    uint64 elapsed = MetricsNow() - start;
+
+    benchSink = benchSink + sum;
+    return elapsed;
+}
+
+//------------------------------------------------------------
+// Calibrate, time and print one benchmark
+//------------------------------------------------------------
+template< typename Op >
+static BenchResult RunBench( const string &name, const string &params,
+                             Op op ) {
+
+    // Double the batch until it runs BENCH_BATCH_MS, which also
+    // warms the caches and the Lagrange weights
+    uint64 iterations = 1;
+    while ( TimeBatch( op, iterations ) < BENCH_BATCH_MS * 1000000ULL ) {
+        iterations *= 2;
+    }
+
+    vector< double > nsPerOp;
+    for ( int r = 0; r < BENCH_REPEATS; r++ ) {
+        nsPerOp.push_back( (double)TimeBatch( op, iterations ) / iterations );
+    }
+    sort( nsPerOp.begin(), nsPerOp.end() );
+
+    BenchResult result;
+    result.name       = name;
+    result.params     = params;
+    result.iterations = iterations;
+    result.nsPerOp    = nsPerOp[ BENCH_REPEATS / 2 ];
+    result.minNs      = nsPerOp.front();
+    result.maxNs      = nsPerOp.back();
+
+    cout << left  << setw( 26 ) << name << setw( 28 ) << params
+         << right << fixed << setprecision( 1 )
+         << setw( 12 ) << result.nsPerOp << " ns/op"
+         << "  (" << result.minNs << " .. " << result.maxNs << ")"
+         << "  x" << iterations << endl;
+
+    return result;
+}
+
+//------------------------------------------------------------
+// BENCH_INPUTS values in [1,prime), the same on every run
+//------------------------------------------------------------
+static vector< int64 > BenchInputs( int64 prime, uint64 seed ) {
+
+    mt19937_64 random( seed );
+    uniform_int_distribution< int64 > value( 1, prime - 1 );
+
+    vector< int64 > inputs( BENCH_INPUTS );
+    for ( size_t i = 0; i < inputs.size(); i++ ) {
+        inputs[ i ] = value( random );
+    }
+    return inputs;
+}
+
+//------------------------------------------------------------
+// Write the results as
+//   { "unit": "ns", "repeats": n, "benchmarks": [
+//     { "name": "", "params": "", "iterations": n,
+//       "ns_per_op": x, "min_ns": x, "max_ns": x }, ... ] }
+//------------------------------------------------------------
+static bool WriteJSON( const string &file, const vector< BenchResult > &results ) {
+
+    ofstream json( file );
+    if ( not json ) {
+        return false;
+    }
+
+    json << fixed << setprecision( 3 );
+    json << "{\n  \"unit\": \"ns\",\n  \"repeats\": " << BENCH_REPEATS
+         << ",\n  \"benchmarks\": [\n";
+
+    for ( size_t r = 0; r < results.size(); r++ ) {
+        const BenchResult &result = results[ r ];
+        json << "    { \"name\": \""     << result.name
+             << "\", \"params\": \""     << result.params
+             << "\", \"iterations\": "   << result.iterations
+             << ", \"ns_per_op\": "      << result.nsPerOp
+             << ", \"min_ns\": "         << result.minNs
+             << ", \"max_ns\": "         << result.maxNs << " }"
+             << ( r + 1 < results.size() ? "," : "" ) << "\n";
+    }
+    json << "  ]\n}\n";
+
+    return bool( json );
+}
+
+//-------------------------------------------------------------------
+int main( int argc, char *argv[] ) {
+
+    //------------------------------------------------------
+    // Parse command line with getopt()
+    extern char *optarg; // defined by getopt
+    int      parse_char;
+    string   filter;
+    string   jsonFile;
+
+    while ( ( parse_char = getopt( argc, argv, "f:j:" ) ) != -1 ) {
+        switch ( parse_char ) {
+        case 'f':
+            filter = optarg;
+            break;
+        case 'j':
+            jsonFile = optarg;
+            break;
+        default :
+            cerr << "Usage: " << argv[0]
+                 << " -f name filter"
+                 << " -j JSON results file"
+                 << endl;
+            return -1;
+        }
+    }
+
+    // Benchmarks log nothing, see MPC_Logger.h
+    SetLogLevel( LOG_ERROR );
+
+    MPC_PolyModule Poly;
+
+    // A Peer that is never started, for LagrangeInterpolate()
+    Peer peer( "127.0.0.1", 0, "Bench", 16, 65 );
+
+    vector< BenchResult > results;
+
+    auto Selected = [&]( const string &name ) {
+        return filter.empty() or name.find( filter ) != string::npos;
+    };
+
+    for ( const BenchPrime &bp : benchPrimes ) {
+        const int64 P      = bp.prime;
+        vector< int64 > in = BenchInputs( P, 1 );
+        string          p  = " prime=" + bp.name;
+
+        // Horner evaluation at one x, as PeerShare does per peer
+        if ( Selected( "Polynomial" ) ) {
+            for ( int degree : { 2, 8, 32, 128 } ) {
+                vector< int64 > a = BenchInputs( P, degree );
+                a.resize( degree + 1 );
+
+                results.push_back( RunBench(
+                    "Polynomial", "degree=" + to_string( degree ) + p,
+                    [&]( uint64 i ) {
+                        return Poly.Polynomial( a, in[ i % BENCH_INPUTS ], P );
+                    } ) );
+            }
+        }
+
+        // One evaluation at the x of every peer, as in DISTRIBUTE
+        if ( Selected( "PolynomialPoints" ) ) {
+            for ( int peers : { 4, 16, 64 } ) {
+                vector< int64 > a = BenchInputs( P, 8 );
+                a.resize( 9 );
+                vector< int64 > x( peers );
+                for ( int j = 0; j < peers; j++ ) {
+                    x[ j ] = j + 1;
+                }
+
+                results.push_back( RunBench(
+                    "PolynomialPoints", "degree=8 peers=" + to_string( peers ) + p,
+                    [&]( uint64 i ) {
+                        return Poly.Polynomial( a, x, P )[ i % peers ];
+                    } ) );
+            }
+        }
+
+        if ( Selected( "MultPoly" ) ) {
+            for ( int degree : { 8, 32, 128 } ) {
+                vector< int64 > a = BenchInputs( P, degree );
+                vector< int64 > b = BenchInputs( P, degree + 1 );
+                a.resize( degree + 1 );
+                b.resize( degree + 1 );
+
+                results.push_back( RunBench(
+                    "MultPoly", "degree=" + to_string( degree ) + p,
+                    [&]( uint64 i ) {
+                        return Poly.MultPoly( a, b, P )[ i % ( degree + 1 ) ];
+                    } ) );
+            }
+        }
+
+        if ( Selected( "ModInverse" ) ) {
+            results.push_back( RunBench(
+                "ModInverse", p.substr( 1 ),
+                [&]( uint64 i ) {
+                    return Poly.ModInverse( in[ i % BENCH_INPUTS ], P );
+                } ) );
+        }
+
+        if ( Selected( "GCD" ) ) {
+            results.push_back( RunBench(
+                "GCD", p.substr( 1 ),
+                [&]( uint64 i ) {
+                    return Poly.GCD( P, in[ i % BENCH_INPUTS ] )[ 0 ];
+                } ) );
+        }
+
+        // Recovery from peers points, with the Lagrange weights
+        // cached as they are between membership changes, and with
+        // the weights computed on every call as after a change
+        for ( bool cached : { true, false } ) {
+            string name = cached ? "LagrangeInterpolate" :
+                                   "LagrangeInterpolateCold";
+            if ( not Selected( name ) ) {
+                continue;
+            }
+            for ( int peers : { 4, 16, 64 } ) {
+                vector< int64 > x( peers );
+                for ( int j = 0; j < peers; j++ ) {
+                    x[ j ] = j + 1;
+                }
+                vector< int64 > f_x = BenchInputs( P, peers );
+                f_x.resize( peers );
+
+                results.push_back( RunBench(
+                    name, "peers=" + to_string( peers ) + p,
+                    [&]( uint64 i ) {
+                        if ( not cached ) {
+                            peer.ClearLagrangeWeights();
+                        }
+                        f_x[ 0 ] = in[ i % BENCH_INPUTS ];
+                        int64 recovered = 0;
+                        peer.LagrangeInterpolate( x, f_x, P, recovered );
+                        return recovered;
+                    } ) );
+            }
+        }
+    }
+
+    if ( jsonFile.size() and not WriteJSON( jsonFile, results ) ) {
+        cerr << "ERROR: Failed to write " << jsonFile << endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,343 @@
+//------------------------------------------------------------------------
+// In-process cluster simulator, built by "make clusterbench" as
+// mpcClusterBench.
+//
+// Starts N MPC_Peer instances on loopback ports in one process,
+// joins them with BuildPeers() through the first peer, then runs
+// rounds in which every peer is sent a DISTRIBUTE and then an LI of
+// the share of the next peer, all peers at once.  Every recovered
+// value is checked against the secret of the share.  Requests go
+// from a driver Peer over the same pooled framed connections the
+// peers use with each other.
+//
+//   mpcClusterBench [-n peers[,peers...]] [-r rounds] [-k numCoef]
+//                   [-P prime] [-p basePort] [-w workers] [-j file.json]
+//     -n  peer counts, each run as its own cluster (default 4)
+//     -r  rounds per cluster (default 100)
+//     -k  share polynomial coefficients, at most the peer count
+//     -P  share prime (default 2^61-1)
+//     -p  first port, each cluster takes peers + 1 ports (default 9000)
+//     -w  MainLoop worker threads per peer (default 2)
+//     -j  also write the results as JSON, for regression tracking
+//
+// Reported per cluster: rounds per second, p50 and p99 latency of
+// a round, of DISTRIBUTE and of LI, and the bytes the peers moved.
+//------------------------------------------------------------------------
+
+#include "MPC_Peer.h"
+#include "MPC_PeerHandler.h"
+
+#include <unistd.h>     // getopt
+
+#include <random>
+#include <fstream>
+#include <iomanip>
+
+#define CLUSTER_TIMEOUT      5     // MainLoop timeOut of the peers, s
+#define CLUSTER_START_WAIT   5000  // ms for the peers to start listening
+
+//------------------------------------------------------------
+// An MPC_Peer whose last recovered value can be checked
+//------------------------------------------------------------
+class SimPeer : public MPC_Peer {
+
+public:
+    SimPeer( int port, string name, int maxpeers ) :
+        MPC_Peer( "127.0.0.1", port, name, maxpeers, CLUSTER_TIMEOUT ) {}
+
+    int64 Recovered() const { return recoveredSecret; }
+};
+
+//------------------------------------------------------------
+// Results of one cluster
+//------------------------------------------------------------
+struct ClusterResult {
+    int    peers;
+    int    rounds;
+    int    errors;        // Failed DISTRIBUTEs and wrong recoveries
+    double seconds;
+    double roundsPerSec;
+    double roundP50, roundP99;           // ms
+    double distributeP50, distributeP99; // ms
+    double liP50, liP99;                 // ms
+    uint64 bytes;         // Sent by every connection of the process
+};
+
+//------------------------------------------------------------
+// Run op( p ) for every peer p at once, recording the time each
+// took in latency.  Returns the number of ops that failed.
+//------------------------------------------------------------
+template< typename Op >
+static int ForAllPeers( int peers, Histogram &latency, Op op ) {
+
+    atomic< int >    failed( 0 );
+    vector< thread > threads;
+
+    for ( int p = 0; p < peers; p++ ) {
+        threads.push_back( thread( [ &, p ]() {
+            uint64 start = MetricsNow();
+            if ( not op( p ) ) {
+                failed++;
+            }
+            latency.Record( MetricsNow() - start );
+        } ) );
+    }
+    for ( size_t t = 0; t < threads.size(); t++ ) {
+        threads[ t ].join();
+    }
+    return failed;
+}
+
+//------------------------------------------------------------
+// Start a cluster of peers on basePort .. basePort + peers - 1,
+// the driver uses basePort + peers, and run rounds on it.
+// Returns false if a peer did not start.  The peers are shut
+// down but never deleted, see main().
+//------------------------------------------------------------
+static bool RunCluster( int peers, int rounds, int numCoef, int64 prime,
+                        int basePort, int workers, ClusterResult &result ) {
+
+    result.peers  = peers;
+    result.rounds = rounds;
+    result.errors = 0;
+
+    mt19937_64 random( peers );
+    uniform_int_distribution< int64 > value( 1, prime - 1 );
+
+    vector< SimPeer * > cluster;
+    vector< int64 >     secrets;
+
+    for ( int p = 0; p < peers; p++ ) {
+        SimPeer *peer = new SimPeer( basePort + p, "Sim" + to_string( p ),
+                                     peers );
+        secrets.push_back( value( random ) );
+        peer->CreatePeerShare( "Sim" + to_string( p ) + "_Share", numCoef,
+                               vector< int64 >(), p + 1, secrets[ p ],
+                               prime, vector< int64 >(), false );
+        peer->SetWorkerPool( workers, DEFAULT_WORKER_QUEUE );
+        peer->StartMainLoop();
+        cluster.push_back( peer );
+    }
+
+    // Requests are sent by a Peer outside the network
+    Peer driver( "127.0.0.1", basePort + peers, "Driver", peers, 65 );
+
+    // Wait for every MainLoop to listen, a PING is replied with the ID
+    for ( int p = 0; p < peers; p++ ) {
+        int waited = 0;
+        while ( driver.ConnectAndSend( "127.0.0.1", basePort + p,
+                                       "PING", "" ).empty() ) {
+            if ( waited >= CLUSTER_START_WAIT ) {
+                cerr << "ERROR: Sim" << p << " is not listening on port "
+                     << basePort + p << endl;
+                for ( int q = 0; q < peers; q++ ) {
+                    cluster[ q ]->Shutdown();
+                }
+                return false;
+            }
+            this_thread::sleep_for( chrono::milliseconds( 100 ) );
+            waited += 100;
+        }
+    }
+
+    // Join every peer to the network through the first
+    for ( int p = 1; p < peers; p++ ) {
+        cluster[ p ]->BuildPeers( "127.0.0.1", basePort, 2 );
+    }
+    for ( int p = 0; p < peers; p++ ) {
+        size_t known = cluster[ p ]->PeerSnapshot()->size();
+        if ( known != (size_t)( peers - 1 ) ) {
+            cerr << "WARNING: " << "Sim" << p << " knows " << known
+                 << " of " << peers - 1 << " peers" << endl;
+        }
+    }
+
+    Histogram roundLatency, distributeLatency, liLatency;
+
+    uint64 bytesBefore = metrics.GetCounter( "mpc_bytes_sent_total" ).Value();
+    uint64 start       = MetricsNow();
+
+    for ( int r = 0; r < rounds; r++ ) {
+        uint64 roundStart = MetricsNow();
+
+        result.errors += ForAllPeers( peers, distributeLatency,
+            [&]( int p ) {
+                vector< string > replies =
+                    driver.ConnectAndSend( "127.0.0.1", basePort + p,
+                                           "DISTRIBUTE", "" );
+                return replies.size() and
+                       replies[ 0 ].find( "FAILED=0" ) != string::npos;
+            } );
+
+        // Peer p recovers the share of peer p + 1
+        result.errors += ForAllPeers( peers, liLatency,
+            [&]( int p ) {
+                int owner = ( p + 1 ) % peers;
+                driver.ConnectAndSend( "127.0.0.1", basePort + p, "LI",
+                                       "Sim" + to_string( owner ) + "_Share" );
+                return cluster[ p ]->Recovered() == secrets[ owner ];
+            } );
+
+        roundLatency.Record( MetricsNow() - roundStart );
+    }
+
+    result.seconds      = ( MetricsNow() - start ) / 1e9;
+    result.roundsPerSec = rounds / result.seconds;
+    result.bytes        =
+        metrics.GetCounter( "mpc_bytes_sent_total" ).Value() - bytesBefore;
+
+    result.roundP50      = roundLatency.Percentile( 0.5 ) / 1e6;
+    result.roundP99      = roundLatency.Percentile( 0.99 ) / 1e6;
+    result.distributeP50 = distributeLatency.Percentile( 0.5 ) / 1e6;
+    result.distributeP99 = distributeLatency.Percentile( 0.99 ) / 1e6;
+    result.liP50         = liLatency.Percentile( 0.5 ) / 1e6;
+    result.liP99         = liLatency.Percentile( 0.99 ) / 1e6;
+
+    for ( int p = 0; p < peers; p++ ) {
+        cluster[ p ]->Shutdown();
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------
+//------------------------------------------------------------
+static void PrintResult( const ClusterResult &result ) {
+
+    cout << fixed << setprecision( 2 )
+         << "peers "        << setw( 3 ) << result.peers
+         << "  rounds "     << result.rounds
+         << "  "            << result.roundsPerSec << " rounds/s"
+         << "  round p50 "  << result.roundP50
+         << " p99 "         << result.roundP99 << " ms"
+         << "  DISTRIBUTE p50 " << result.distributeP50
+         << " p99 "         << result.distributeP99 << " ms"
+         << "  LI p50 "     << result.liP50
+         << " p99 "         << result.liP99 << " ms"
+         << "  bytes "      << result.bytes
+         << " (" << result.bytes / max( result.rounds, 1 ) << "/round)"
+         << "  errors "     << result.errors << endl;
+}
+
+//------------------------------------------------------------
+// Write the results as
+//   { "clusters": [ { "peers": n, "rounds": n, ... }, ... ] }
+//------------------------------------------------------------
+static bool WriteJSON( const string &file,
+                       const vector< ClusterResult > &results ) {
+
+    ofstream json( file );
+    if ( not json ) {
+        return false;
+    }
+
+    json << fixed << setprecision( 3 );
+    json << "{\n  \"clusters\": [\n";
+
+    for ( size_t r = 0; r < results.size(); r++ ) {
+        const ClusterResult &result = results[ r ];
+        json << "    { \"peers\": "           << result.peers
+             << ", \"rounds\": "              << result.rounds
+             << ", \"errors\": "              << result.errors
+             << ", \"seconds\": "             << result.seconds
+             << ", \"rounds_per_sec\": "      << result.roundsPerSec
+             << ", \"round_p50_ms\": "        << result.roundP50
+             << ", \"round_p99_ms\": "        << result.roundP99
+             << ", \"distribute_p50_ms\": "   << result.distributeP50
+             << ", \"distribute_p99_ms\": "   << result.distributeP99
+             << ", \"li_p50_ms\": "           << result.liP50
+             << ", \"li_p99_ms\": "           << result.liP99
+             << ", \"bytes\": "               << result.bytes << " }"
+             << ( r + 1 < results.size() ? "," : "" ) << "\n";
+    }
+    json << "  ]\n}\n";
+
+    return bool( json );
+}
+
+//-------------------------------------------------------------------
+int main( int argc, char *argv[] ) {
+
+    //------------------------------------------------------
+    // Parse command line with getopt()
+    extern char *optarg; // defined by getopt
+    int      parse_char;
+    string   peerCounts = "4";
+    int      rounds     = 100;
+    int      numCoef    = 3;
+    int64    prime      = 2305843009213693951LL; // 2^61-1
+    int      basePort   = 9000;
+    int      workers    = 2;
+    string   jsonFile;
+
+    while ( ( parse_char = getopt( argc, argv, "n:r:k:P:p:w:j:" ) ) != -1 ) {
+        switch ( parse_char ) {
+        case 'n':
+            peerCounts = optarg;
+            break;
+        case 'r':
+            rounds = stoi( optarg );
+            break;
+        case 'k':
+            numCoef = stoi( optarg );
+            break;
+        case 'P':
+            prime = stoll( optarg );
+            break;
+        case 'p':
+            basePort = stoi( optarg );
+            break;
+        case 'w':
+            workers = stoi( optarg );
+            break;
+        case 'j':
+            jsonFile = optarg;
+            break;
+        default :
+            cerr << "Usage: " << argv[0]
+                 << " -n peers[,peers...] -r rounds -k numCoef -P prime"
+                 << " -p basePort -w workers -j JSON results file"
+                 << endl;
+            return -1;
+        }
+    }
+
+    // Only errors are logged, see MPC_Logger.h
+    SetLogLevel( LOG_ERROR );
+
+    vector< ClusterResult > results;
+
+    stringstream counts( peerCounts );
+    string       count;
+    while ( getline( counts, count, ',' ) ) {
+        int peers = stoi( count );
+        if ( peers < 2 or numCoef < 2 or numCoef > peers ) {
+            cerr << "ERROR: " << peers << " peers need 2 <= numCoef <= peers"
+                 << endl;
+            return -1;
+        }
+
+        ClusterResult result;
+        if ( not RunCluster( peers, rounds, numCoef, prime, basePort,
+                             workers, result ) ) {
+            LogFlush();
+            return -1;
+        }
+        PrintResult( result );
+        results.push_back( result );
+
+        // The peers of this cluster are still shutting down
+        basePort += peers + 1;
+    }
+
+    if ( jsonFile.size() and not WriteJSON( jsonFile, results ) ) {
+        cerr << "ERROR: Failed to write " << jsonFile << endl;
+        return -1;
+    }
+
+    LogFlush();
+
+    // The peers are never deleted, their MainLoop threads are
+    // detached and end with the process
+    return 0;
+}
@@ -10,11 +10,29 @@ using namespace std;
 
 #define MAX_CLIENT_SOCKETS 32    // Not used in P2P
 #define BUFFER_LENGTH      4096  // Not used in P2P
+#define MAX_EPOLL_EVENTS   64    // Events per epoll_wait in Peer::MainLoop
+#define MIN_WORKER_THREADS 4     // Smallest Peer::MainLoop worker pool
+#define DEFAULT_WORKER_QUEUE 256 // Requests waiting for a worker thread
+#define REPLY_TIMEOUT      30    // Seconds to wait for a peer reply
+#define RING_BUFFER_LENGTH 16384 // Initial PeerConnection receive buffer
+#define HEARTBEAT_FAILURES 3     // PINGs failed in a row to evict a peer
+#define HEARTBEAT_TIMEOUT  2     // Seconds to wait for a PING reply
+#define HEARTBEAT_HISTORY  16    // PING round trips kept per peer
+#define SHARE_MEMO_LIMIT   8     // x sets kept by PeerShare::Evaluate()
+#define LAGRANGE_WEIGHTS_LIMIT 64 // Weight sets kept by Peer::LagrangeWeights()
+#define LOG_FLUSH_INTERVAL 20    // Milliseconds between log flushes
+#define LOG_BUFFER_LIMIT   65536 // Bytes a thread logs before a flush
+#define HISTOGRAM_SUB_BITS 4     // Histogram buckets per power of 2: 2^4
 
 // 64 bit integers
 typedef long long int64;
 typedef unsigned long long uint64;
 
+// 128 bit integers (gcc/clang extension) for exact products of two int64
+// values before they are reduced modulo a prime
+__extension__ typedef __int128          int128;
+__extension__ typedef unsigned __int128 uint128;
+
 // Array of int64 to hold share values [ID, x, f_x] for binary socket comms
 // in the ClientServer application. Not used in P2P
 typedef struct sharebin { int64 share[3]; } sharebin; // sizeof() = 24
@@ -0,0 +1,131 @@
+#include "MPC_ConnectionPool.h"
+
+//------------------------------------------------------------
+// Deleter of pooled connections, run when no thread uses one
+//------------------------------------------------------------
+static void CloseConnection( PeerConnection *pc ) {
+    pc->Close();
+    delete pc;
+}
+
+//------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------
+ConnectionPool::ConnectionPool( int replyTimeout ) :
+    replyTimeout( replyTimeout ) {}
+
+//------------------------------------------------------------
+// Destructor
+// Connections still in use are closed by their last user
+//------------------------------------------------------------
+ConnectionPool::~ConnectionPool() {
+    connections.clear();
+}
+
+//------------------------------------------------------------
+// Returns the connection to peerID, shared with other callers.
+// reused is set true when it is an existing connection, false when
+// it was just connected.  A new connection that failed, or did not
+// connect within connectTimeoutMs when it is not -1, is returned
+// with IsOpen() false.
+//------------------------------------------------------------
+shared_ptr< PeerConnection > ConnectionPool::Acquire( string peerID,
+                                                      string host,
+                                                      int port,
+                                                      bool &reused,
+                                                      int connectTimeoutMs ) {
+    shared_ptr< PeerConnection > pc;
+
+    poolLock.lock();
+    if ( connections.count( peerID ) ) {
+        pc = connections[ peerID ];
+    }
+    poolLock.unlock();
+
+    if ( pc and pc->IsAlive() ) {
+        reused = true;
+        return( pc );
+    }
+    if ( pc ) {
+        DebugMsg( "ConnectionPool::Acquire closed connection to " + peerID );
+        Discard( pc );
+    }
+
+    // No open connection, connect a new one outside the lock
+    reused = false;
+
+    pc.reset( new PeerConnection( peerID, host, port, 0, connectTimeoutMs ),
+              CloseConnection );
+    pc->StartFramed( replyTimeout );
+
+    if ( not pc->IsOpen() ) {
+        return( pc );
+    }
+
+    lock_guard< mutex > lock( poolLock );
+
+    shared_ptr< PeerConnection > &current = connections[ peerID ];
+    if ( current and current->IsOpen() ) {
+        // Another caller connected first, use theirs
+        reused = true;
+        return( current );
+    }
+    current = pc;
+    return( pc );
+}
+
+//------------------------------------------------------------
+// Drop a connection that failed.  Requests in flight on it fail,
+// the next Acquire() connects again.
+//------------------------------------------------------------
+void ConnectionPool::Discard( const shared_ptr< PeerConnection > &pc ) {
+
+    poolLock.lock();
+    map< string, shared_ptr< PeerConnection > >::iterator ci;
+    ci = connections.find( pc->PeerID() );
+    if ( ci != connections.end() and ci->second == pc ) {
+        connections.erase( ci );
+    }
+    poolLock.unlock();
+
+    pc->Shutdown();
+}
+
+//------------------------------------------------------------
+// Drop the connection of a peer that left the network
+//------------------------------------------------------------
+void ConnectionPool::Remove( string peerID ) {
+
+    shared_ptr< PeerConnection > pc;
+
+    poolLock.lock();
+    if ( connections.count( peerID ) ) {
+        pc = connections[ peerID ];
+        connections.erase( peerID );
+    }
+    poolLock.unlock();
+
+    if ( pc ) {
+        pc->Shutdown();
+    }
+}
+
+//------------------------------------------------------------
+// Bytes read and written by the open connection to each peer
+//------------------------------------------------------------
+vector< ConnectionTraffic > ConnectionPool::Traffic() {
+
+    lock_guard< mutex > lock( poolLock );
+
+    vector< ConnectionTraffic > traffic;
+
+    map< string, shared_ptr< PeerConnection > >::iterator ci;
+    for ( ci = connections.begin(); ci != connections.end(); ++ci ) {
+        ConnectionTraffic peer;
+        peer.peerID   = ci->first;
+        peer.bytesIn  = ci->second->BytesIn();
+        peer.bytesOut = ci->second->BytesOut();
+        traffic.push_back( peer );
+    }
+    return( traffic );
+}
@@ -0,0 +1,55 @@
+#ifndef MPC_CONNECTIONPOOL_H
+#define MPC_CONNECTIONPOOL_H
+
+#include <memory>
+
+#include "MPC_PeerConnection.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Bytes moved on the pooled connection to one peer
+//------------------------------------------------------------
+struct ConnectionTraffic {
+    string peerID;
+    uint64 bytesIn;
+    uint64 bytesOut;
+};
+
+//------------------------------------------------------------
+// Persistent framed connections to remote peers, kept open
+// between messages so that Peer::ConnectAndSend() does not pay a
+// TCP handshake and leave a TIME_WAIT socket for every message.
+//
+// There is one connection per peer, shared by every thread that
+// sends to it: requests are multiplexed on the connection and
+// their replies matched by requestID (see PeerConnection).
+// Acquire() returns the connection, or a new one when there is
+// none or the remote peer has closed it, so a peer is reconnected
+// lazily on its next message.  Discard() drops a connection that
+// failed; it is closed when the last thread using it lets go.
+//------------------------------------------------------------
+class ConnectionPool {
+
+private:
+    // [ peerID ] : connection, guarded by poolLock
+    map< string, shared_ptr< PeerConnection > > connections;
+    mutex poolLock;
+    int   replyTimeout; // Seconds to wait for a reply
+
+public:
+    ConnectionPool( int replyTimeout );
+    ~ConnectionPool();
+
+    shared_ptr< PeerConnection > Acquire( string peerID, string host,
+                                          int port, bool &reused,
+                                          int connectTimeoutMs = -1 );
+
+    void Discard( const shared_ptr< PeerConnection > &pc );
+
+    void Remove( string peerID );
+
+    vector< ConnectionTraffic > Traffic();
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "MPC_Heartbeat.h"
+
+//------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------
+Heartbeat::Heartbeat( int maxFailures, size_t historyLength ) :
+    historyLength( historyLength ), maxFailures( max( maxFailures, 1 ) ) {}
+
+//------------------------------------------------------------
+// PINGs that must fail in a row before a peer is evicted
+//------------------------------------------------------------
+void Heartbeat::SetMaxFailures( int failures ) {
+    lock_guard< mutex > lock( healthLock );
+    maxFailures = max( failures, 1 );
+}
+
+//------------------------------------------------------------
+// Record the result of one PING to peerID.  Returns true when
+// maxFailures PINGs in a row have failed.
+//------------------------------------------------------------
+bool Heartbeat::Record( string peerID, bool replied, double rttMs ) {
+
+    lock_guard< mutex > lock( healthLock );
+
+    PeerHealth &peer = health[ peerID ];
+    peer.pings++;
+
+    if ( replied ) {
+        peer.failures = 0;
+        peer.lastSeen = time( NULL );
+        peer.rtt.push_back( rttMs );
+        if ( peer.rtt.size() > historyLength ) {
+            peer.rtt.pop_front();
+        }
+        return( false );
+    }
+
+    peer.failures++;
+    peer.lost++;
+    return( peer.failures >= maxFailures );
+}
+
+//------------------------------------------------------------
+// Drop the history of a peer that left the network
+//------------------------------------------------------------
+void Heartbeat::Forget( string peerID ) {
+    lock_guard< mutex > lock( healthLock );
+    health.erase( peerID );
+}
+
+//------------------------------------------------------------
+// One line per peer:
+//   peerID rtt=last/min/avg/max ms failures=f/max lost=l/pings seen=s
+// where seen is seconds since the last reply, -1 for never
+//------------------------------------------------------------
+string Heartbeat::Report() {
+
+    lock_guard< mutex > lock( healthLock );
+
+    time_t        now = time( NULL );
+    ostringstream ostrm;
+    ostrm.setf( ios::fixed );
+    ostrm.precision( 3 );
+
+    map< string, PeerHealth >::iterator hi;
+    for ( hi = health.begin(); hi != health.end(); ++hi ) {
+        PeerHealth &peer = hi->second;
+
+        double last = 0, low = 0, sum = 0, high = 0;
+        if ( peer.rtt.size() ) {
+            last = peer.rtt.back();
+            low  = *min_element( peer.rtt.begin(), peer.rtt.end() );
+            high = *max_element( peer.rtt.begin(), peer.rtt.end() );
+            for ( size_t i = 0; i < peer.rtt.size(); i++ ) {
+                sum += peer.rtt[ i ];
+            }
+        }
+        double avg = peer.rtt.size() ? sum / peer.rtt.size() : 0;
+
+        ostrm << hi->first << " rtt=" << last << "/" << low << "/"
+              << avg << "/" << high << " ms"
+              << " failures=" << peer.failures << "/" << maxFailures
+              << " lost=" << peer.lost << "/" << peer.pings
+              << " seen=" << ( peer.lastSeen ? now - peer.lastSeen : -1 )
+              << "\n";
+    }
+    return ostrm.str();
+}
@@ -0,0 +1,53 @@
+#ifndef MPC_HEARTBEAT_H
+#define MPC_HEARTBEAT_H
+
+#include <deque>
+
+#include "MPC_PeerCommon.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Health of one remote peer, kept by Heartbeat
+//------------------------------------------------------------
+struct PeerHealth {
+    deque< double > rtt;          // Recent PING round trips, ms
+    int             failures;     // PINGs failed in a row
+    uint64          pings;        // PINGs sent
+    uint64          lost;         // PINGs failed in all
+    time_t          lastSeen;     // Time of the last PING reply
+
+    PeerHealth() : failures( 0 ), pings( 0 ), lost( 0 ), lastSeen( 0 ) {}
+};
+
+//------------------------------------------------------------
+// Class Heartbeat
+// Results of the PINGs sent by Peer::CheckLivePeers().  A peer is
+// only evicted after maxFailures PINGs in a row fail, so that a
+// single slow reply or dropped connection does not remove it, and
+// the last historyLength round trips of each peer are kept for
+// the HEALTH handler.
+//------------------------------------------------------------
+class Heartbeat {
+
+private:
+    // [ peerID ] : health, guarded by healthLock
+    map< string, PeerHealth > health;
+    mutex  healthLock;
+    size_t historyLength;
+    int    maxFailures;
+
+public:
+    Heartbeat( int maxFailures, size_t historyLength );
+
+    void SetMaxFailures( int failures );
+
+    // Returns true when the peer should be evicted
+    bool Record( string peerID, bool replied, double rttMs );
+
+    void Forget( string peerID );
+
+    string Report();
+};
+
+#endif
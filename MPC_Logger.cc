@@ -0,0 +1,205 @@
+#include "MPC_Logger.h"
+
+#include <stdlib.h>     // atexit
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+
+//------------------------------------------------------------
+// Messages at or above logLevel are logged
+//------------------------------------------------------------
+#ifdef DEBUG
+atomic< int > logLevel( LOG_DEBUG );
+#else
+atomic< int > logLevel( LOG_INFO );
+#endif
+
+namespace {
+
+//------------------------------------------------------------
+// Lines logged by one thread and not yet written.  lock is only
+// taken by the thread that owns the buffer and by the flusher, so
+// threads never wait on each other to log.
+//------------------------------------------------------------
+struct LogBuffer {
+    mutex  lock;
+    string lines;
+};
+
+//------------------------------------------------------------
+// Background thread that writes every LogBuffer to stdout each
+// LOG_FLUSH_INTERVAL ms, or sooner when woken by an ERROR or a
+// full buffer.  Never destroyed, so that detached threads can
+// still log while the process exits, LogFlush() runs at exit.
+//------------------------------------------------------------
+class LogFlusher {
+
+private:
+    // Buffers of every thread that logged, guarded by registryLock
+    vector< shared_ptr< LogBuffer > > buffers;
+    mutex registryLock;
+
+    mutex              flushLock; // Keeps whole flushes in order
+    mutex              wakeLock;
+    condition_variable wake;
+    bool               woken;
+
+    void Run() {
+        while ( true ) {
+            {
+                unique_lock< mutex > lock( wakeLock );
+                wake.wait_for( lock,
+                               chrono::milliseconds( LOG_FLUSH_INTERVAL ),
+                               [this]{ return woken; } );
+                woken = false;
+            }
+            Flush();
+        }
+    }
+
+public:
+    LogFlusher() : woken( false ) {
+        thread flusher( &LogFlusher::Run, this );
+        flusher.detach();
+    }
+
+    void Register( const shared_ptr< LogBuffer > &buffer ) {
+        lock_guard< mutex > lock( registryLock );
+        buffers.push_back( buffer );
+    }
+
+    void Wake() {
+        {
+            lock_guard< mutex > lock( wakeLock );
+            woken = true;
+        }
+        wake.notify_one();
+    }
+
+    // Write the lines of every buffer with one write, and drop the
+    // buffers of threads that have exited
+    void Flush() {
+        lock_guard< mutex > flush( flushLock );
+
+        string out;
+        {
+            lock_guard< mutex > lock( registryLock );
+
+            for ( size_t b = 0; b < buffers.size(); ) {
+                string lines;
+                {
+                    lock_guard< mutex > bufferLock( buffers[ b ]->lock );
+                    lines.swap( buffers[ b ]->lines );
+                }
+                out += lines;
+
+                if ( buffers[ b ].use_count() == 1 ) {
+                    buffers[ b ] = buffers.back();
+                    buffers.pop_back();
+                }
+                else {
+                    b++;
+                }
+            }
+        }
+
+        if ( out.size() ) {
+            cout.write( out.data(), out.size() );
+            cout.flush();
+        }
+    }
+};
+
+LogFlusher &Flusher() {
+    static LogFlusher *flusher = new LogFlusher();
+    return *flusher;
+}
+
+//------------------------------------------------------------
+// The LogBuffer of a thread and the "[thread id] " that starts
+// each of its lines
+//------------------------------------------------------------
+struct ThreadLog {
+    shared_ptr< LogBuffer > buffer;
+    string                  prefix;
+
+    ThreadLog() : buffer( make_shared< LogBuffer >() ) {
+        ostringstream ostrm;
+        ostrm << "[" << this_thread::get_id() << "] ";
+        prefix = ostrm.str();
+
+        Flusher().Register( buffer );
+    }
+};
+
+void FlushAtExit() { LogFlush(); }
+
+} // namespace
+
+//------------------------------------------------------------
+// Appends msg to the buffer of this thread, written to the console
+// by the flusher thread.  Called by the log macros when level is
+// enabled.
+//------------------------------------------------------------
+void LogWrite( LogLevel level, const string &msg ) {
+
+    static thread_local ThreadLog local;
+    static bool registered = ( atexit( FlushAtExit ) == 0 );
+    (void) registered;
+
+    size_t size;
+    {
+        lock_guard< mutex > lock( local.buffer->lock );
+        local.buffer->lines += local.prefix;
+        local.buffer->lines += msg;
+        local.buffer->lines += '\n';
+        size = local.buffer->lines.size();
+    }
+
+    if ( level >= LOG_ERROR or size >= LOG_BUFFER_LIMIT ) {
+        Flusher().Wake();
+    }
+}
+
+//------------------------------------------------------------
+// Write every logged line now
+//------------------------------------------------------------
+void LogFlush() {
+    Flusher().Flush();
+}
+
+//------------------------------------------------------------
+//------------------------------------------------------------
+void SetLogLevel( LogLevel level ) {
+    logLevel.store( level, memory_order_relaxed );
+}
+
+LogLevel GetLogLevel() {
+    return (LogLevel) logLevel.load( memory_order_relaxed );
+}
+
+//------------------------------------------------------------
+// Level names used by the logLevel config key and LOGLEVEL:
+//------------------------------------------------------------
+static const char *logLevelNames[] = { "DEBUG", "INFO", "WARNING",
+                                       "ERROR", "OFF" };
+
+bool ParseLogLevel( const string &name, LogLevel &level ) {
+    for ( int l = LOG_DEBUG; l <= LOG_OFF; l++ ) {
+        if ( name == logLevelNames[ l ] ) {
+            level = (LogLevel) l;
+            return true;
+        }
+    }
+    return false;
+}
+
+string LogLevelName( LogLevel level ) {
+    return logLevelNames[ level ];
+}
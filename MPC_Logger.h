@@ -0,0 +1,46 @@
+#ifndef MPC_LOGGER_H
+#define MPC_LOGGER_H
+
+#include <string>
+#include <atomic>
+
+#include "MPC_Common.h"
+
+using namespace std;
+
+//#define DEBUG // Comment out to start at LOG_INFO, not LOG_DEBUG
+
+//------------------------------------------------------------
+// Severity of a log message.  Messages below logLevel are not
+// logged, LOG_OFF logs nothing.
+//------------------------------------------------------------
+enum LogLevel { LOG_DEBUG = 0, LOG_INFO, LOG_WARNING, LOG_ERROR, LOG_OFF };
+
+extern atomic< int > logLevel; // In MPC_Logger.cc
+
+inline bool LogEnabled( LogLevel level ) {
+    return level >= logLevel.load( memory_order_relaxed );
+}
+
+// Declarations MPC_Logger.cc
+void     LogWrite( LogLevel level, const string &msg );
+void     LogFlush();
+void     SetLogLevel( LogLevel level );
+LogLevel GetLogLevel();
+bool     ParseLogLevel( const string &name, LogLevel &level );
+string   LogLevelName( LogLevel level );
+
+//------------------------------------------------------------
+// Log macros.  msg is only evaluated, and its strings only
+// concatenated, when the level is enabled, so a disabled
+// DebugMsg costs one relaxed load.
+//------------------------------------------------------------
+#define LogMsg( level, msg ) \
+    do { if ( LogEnabled( level ) ) { LogWrite( level, msg ); } } while ( 0 )
+
+#define DebugMsg( msg )   LogMsg( LOG_DEBUG,   msg )
+#define ConsoleMsg( msg ) LogMsg( LOG_INFO,    msg )
+#define WarningMsg( msg ) LogMsg( LOG_WARNING, msg )
+#define ErrorMsg( msg )   LogMsg( LOG_ERROR,   msg )
+
+#endif
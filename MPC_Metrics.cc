@@ -0,0 +1,257 @@
+#include "MPC_Metrics.h"
+
+#include <math.h>       // ceil
+
+#include <iomanip>
+
+//------------------------------------------------------------
+// Every metric of the process: handlers, connections, heartbeats
+// and the peerLock waits of every Peer, which share one histogram.
+// Never destroyed, so that detached worker threads can still record
+// while the process exits.
+//------------------------------------------------------------
+MetricsRegistry &metrics = *new MetricsRegistry();
+
+//------------------------------------------------------------
+// Constructor
+//------------------------------------------------------------
+Histogram::Histogram() : count( 0 ), sum( 0 ), high( 0 ) {
+    for ( int b = 0; b < NUM_BUCKETS; b++ ) {
+        buckets[ b ].store( 0, memory_order_relaxed );
+    }
+}
+
+//------------------------------------------------------------
+// Values below SUB_BUCKETS have a bucket each.  Above, the bucket
+// is the position of the highest set bit and the HISTOGRAM_SUB_BITS
+// bits below it.
+//------------------------------------------------------------
+size_t Histogram::Bucket( uint64 value ) {
+
+    if ( value < SUB_BUCKETS ) {
+        return value;
+    }
+
+    int shift = 63 - __builtin_clzll( value ) - HISTOGRAM_SUB_BITS;
+
+    return ( shift + 1 ) * SUB_BUCKETS +
+           ( ( value >> shift ) & ( SUB_BUCKETS - 1 ) );
+}
+
+//------------------------------------------------------------
+// Largest value that falls in bucket
+//------------------------------------------------------------
+uint64 Histogram::BucketHigh( size_t bucket ) {
+
+    if ( bucket < SUB_BUCKETS ) {
+        return bucket;
+    }
+
+    int    shift = bucket / SUB_BUCKETS - 1;
+    uint64 low   = (uint64)( SUB_BUCKETS + bucket % SUB_BUCKETS ) << shift;
+
+    return low + ( ( 1ULL << shift ) - 1 );
+}
+
+//------------------------------------------------------------
+//------------------------------------------------------------
+void Histogram::Record( uint64 ns ) {
+
+    buckets[ Bucket( ns ) ].fetch_add( 1, memory_order_relaxed );
+    count.fetch_add( 1, memory_order_relaxed );
+    sum.fetch_add( ns, memory_order_relaxed );
+
+    uint64 previous = high.load( memory_order_relaxed );
+    while ( ns > previous and
+            not high.compare_exchange_weak( previous, ns,
+                                            memory_order_relaxed ) ) {}
+}
+
+//------------------------------------------------------------
+// Value below which a fraction q of the recorded values fall,
+// rounded up to the end of its bucket.  0 if nothing is recorded.
+//------------------------------------------------------------
+uint64 Histogram::Percentile( double q ) const {
+
+    // Count from the buckets, Record() may be adding to them
+    vector< uint64 > counts( NUM_BUCKETS );
+    uint64           total = 0;
+    for ( int b = 0; b < NUM_BUCKETS; b++ ) {
+        counts[ b ] = buckets[ b ].load( memory_order_relaxed );
+        total      += counts[ b ];
+    }
+    if ( total == 0 ) {
+        return 0;
+    }
+
+    uint64 rank = max( (uint64)ceil( q * total ), (uint64)1 );
+    uint64 seen = 0;
+    for ( int b = 0; b < NUM_BUCKETS; b++ ) {
+        seen += counts[ b ];
+        if ( seen >= rank ) {
+            return min( BucketHigh( b ), Max() );
+        }
+    }
+    return Max();
+}
+
+//------------------------------------------------------------
+// Returns the counter name{labels}, created at 0 on first use.
+// helpText is the Prometheus HELP of name.
+//------------------------------------------------------------
+Counter &MetricsRegistry::GetCounter( const string &name,
+                                      const string &labels,
+                                      const string &helpText ) {
+    MetricKey key( name, labels );
+    {
+        shared_lock< shared_mutex > lock( registryLock );
+        map< MetricKey, unique_ptr< Counter > >::iterator ci =
+            counters.find( key );
+        if ( ci != counters.end() ) {
+            return *ci->second;
+        }
+    }
+
+    unique_lock< shared_mutex > lock( registryLock );
+
+    unique_ptr< Counter > &counter = counters[ key ];
+    if ( not counter ) {
+        counter.reset( new Counter() );
+        if ( helpText.size() ) {
+            help[ name ] = helpText;
+        }
+    }
+    return *counter;
+}
+
+//------------------------------------------------------------
+// Returns the histogram name{labels}, created empty on first use
+//------------------------------------------------------------
+Histogram &MetricsRegistry::GetHistogram( const string &name,
+                                          const string &labels,
+                                          const string &helpText ) {
+    MetricKey key( name, labels );
+    {
+        shared_lock< shared_mutex > lock( registryLock );
+        map< MetricKey, unique_ptr< Histogram > >::iterator hi =
+            histograms.find( key );
+        if ( hi != histograms.end() ) {
+            return *hi->second;
+        }
+    }
+
+    unique_lock< shared_mutex > lock( registryLock );
+
+    unique_ptr< Histogram > &histogram = histograms[ key ];
+    if ( not histogram ) {
+        histogram.reset( new Histogram() );
+        if ( helpText.size() ) {
+            help[ name ] = helpText;
+        }
+    }
+    return *histogram;
+}
+
+//------------------------------------------------------------
+// One line per metric, for the STATS: handler:
+//   name{labels} value
+//   name{labels} count=n mean=us p50=us p90=us p99=us p999=us max=us
+//------------------------------------------------------------
+string MetricsRegistry::Report() {
+
+    shared_lock< shared_mutex > lock( registryLock );
+
+    ostringstream ostrm;
+    ostrm.setf( ios::fixed );
+    ostrm.precision( 1 );
+
+    map< MetricKey, unique_ptr< Counter > >::iterator ci;
+    for ( ci = counters.begin(); ci != counters.end(); ++ci ) {
+        ostrm << ci->first.first;
+        if ( ci->first.second.size() ) {
+            ostrm << "{" << ci->first.second << "}";
+        }
+        ostrm << " " << ci->second->Value() << "\n";
+    }
+
+    map< MetricKey, unique_ptr< Histogram > >::iterator hi;
+    for ( hi = histograms.begin(); hi != histograms.end(); ++hi ) {
+        Histogram &h = *hi->second;
+        uint64 count = h.Count();
+
+        ostrm << hi->first.first;
+        if ( hi->first.second.size() ) {
+            ostrm << "{" << hi->first.second << "}";
+        }
+        ostrm << " count=" << count
+              << " mean=" << ( count ? h.Sum() / 1e3 / count : 0.0 )
+              << " p50="  << h.Percentile( 0.5 ) / 1e3
+              << " p90="  << h.Percentile( 0.9 ) / 1e3
+              << " p99="  << h.Percentile( 0.99 ) / 1e3
+              << " p999=" << h.Percentile( 0.999 ) / 1e3
+              << " max="  << h.Max() / 1e3 << " us\n";
+    }
+
+    return ostrm.str();
+}
+
+//------------------------------------------------------------
+// Every metric in the Prometheus text format.  A Histogram is a
+// summary in seconds with 0.5 0.9 0.99 and 0.999 quantiles.
+//------------------------------------------------------------
+string MetricsRegistry::Prometheus() {
+
+    shared_lock< shared_mutex > lock( registryLock );
+
+    ostringstream ostrm;
+    ostrm << setprecision( 9 );
+
+    string family; // Name of the last HELP and TYPE written
+
+    map< MetricKey, unique_ptr< Counter > >::iterator ci;
+    for ( ci = counters.begin(); ci != counters.end(); ++ci ) {
+        const string &name = ci->first.first;
+        if ( name != family ) {
+            family = name;
+            if ( help.count( name ) ) {
+                ostrm << "# HELP " << name << " " << help[ name ] << "\n";
+            }
+            ostrm << "# TYPE " << name << " counter\n";
+        }
+        ostrm << name;
+        if ( ci->first.second.size() ) {
+            ostrm << "{" << ci->first.second << "}";
+        }
+        ostrm << " " << ci->second->Value() << "\n";
+    }
+
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    map< MetricKey, unique_ptr< Histogram > >::iterator hi;
+    for ( hi = histograms.begin(); hi != histograms.end(); ++hi ) {
+        const string &name   = hi->first.first;
+        const string &labels = hi->first.second;
+        Histogram    &h      = *hi->second;
+
+        if ( name != family ) {
+            family = name;
+            if ( help.count( name ) ) {
+                ostrm << "# HELP " << name << " " << help[ name ] << "\n";
+            }
+            ostrm << "# TYPE " << name << " summary\n";
+        }
+
+        string separator = labels.size() ? labels + "," : "";
+        for ( size_t q = 0; q < 4; q++ ) {
+            ostrm << name << "{" << separator << "quantile=\""
+                  << quantiles[ q ] << "\"} "
+                  << h.Percentile( quantiles[ q ] ) / 1e9 << "\n";
+        }
+
+        string braced = labels.size() ? "{" + labels + "}" : "";
+        ostrm << name << "_sum"   << braced << " " << h.Sum() / 1e9 << "\n"
+              << name << "_count" << braced << " " << h.Count() << "\n";
+    }
+
+    return ostrm.str();
+}
@@ -0,0 +1,101 @@
+#ifndef MPC_METRICS_H
+#define MPC_METRICS_H
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+#include "MPC_PeerCommon.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Monotonic time in nanoseconds, for the latencies recorded in a
+// Histogram
+//------------------------------------------------------------
+inline uint64 MetricsNow() {
+    return chrono::duration_cast< chrono::nanoseconds >(
+        chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+//------------------------------------------------------------
+// A count that only goes up, updated with one relaxed atomic add
+//------------------------------------------------------------
+class Counter {
+
+private:
+    atomic< uint64 > value;
+
+public:
+    Counter() : value( 0 ) {}
+
+    void   Add( uint64 n = 1 ) { value.fetch_add( n, memory_order_relaxed ); }
+    uint64 Value() const       { return value.load( memory_order_relaxed ); }
+};
+
+//------------------------------------------------------------
+// Class Histogram
+// Latencies in nanoseconds in HDR style log-linear buckets: each
+// power of 2 is split into 2^HISTOGRAM_SUB_BITS buckets, so a
+// percentile is within 1 / 2^HISTOGRAM_SUB_BITS of the true value
+// over the whole uint64 range.  Record() is a few relaxed atomic
+// adds, threads never wait on each other.
+//------------------------------------------------------------
+class Histogram {
+
+private:
+    static const int SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+    static const int NUM_BUCKETS = ( 65 - HISTOGRAM_SUB_BITS ) * SUB_BUCKETS;
+
+    atomic< uint64 > buckets[ NUM_BUCKETS ];
+    atomic< uint64 > count;
+    atomic< uint64 > sum;
+    atomic< uint64 > high;
+
+    static size_t Bucket( uint64 value );
+    static uint64 BucketHigh( size_t bucket );
+
+public:
+    Histogram();
+
+    void Record( uint64 ns );
+
+    uint64 Count() const { return count.load( memory_order_relaxed ); }
+    uint64 Sum()   const { return sum.load( memory_order_relaxed ); }
+    uint64 Max()   const { return high.load( memory_order_relaxed ); }
+
+    uint64 Percentile( double q ) const;
+};
+
+//------------------------------------------------------------
+// Class MetricsRegistry
+// Counters and Histograms by name and Prometheus labels, e.g.
+//   GetHistogram( "mpc_handler_seconds", "handler=\"LI\"" )
+// A metric is created on first use and lives as long as the
+// registry, so callers may keep the reference.  Lookups share
+// registryLock, only a new metric takes it exclusively.
+//------------------------------------------------------------
+class MetricsRegistry {
+
+private:
+    typedef pair< string, string > MetricKey; // name, labels
+
+    map< MetricKey, unique_ptr< Counter > >   counters;
+    map< MetricKey, unique_ptr< Histogram > > histograms;
+    map< string, string >                     help; // [ name ] : help
+    shared_mutex registryLock;
+
+public:
+    Counter   &GetCounter  ( const string &name, const string &labels = "",
+                             const string &helpText = "" );
+    Histogram &GetHistogram( const string &name, const string &labels = "",
+                             const string &helpText = "" );
+
+    string Report();
+
+    string Prometheus();
+};
+
+extern MetricsRegistry &metrics; // In MPC_Metrics.cc
+
+#endif
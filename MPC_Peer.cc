@@ -1,7 +1,29 @@
 #include "MPC_Peer.h"
 
-// Global mutex for Peers map in Peer classs
-mutex peerLock;
+//------------------------------------------------------------
+// Lock peerLock, recording how long the caller waited for it
+//------------------------------------------------------------
+unique_lock< mutex > Peer::LockPeers() {
+
+    static Histogram &wait =
+        metrics.GetHistogram( "mpc_peer_lock_wait_seconds", "",
+                              "Time spent waiting for peerLock" );
+
+    uint64 start = MetricsNow();
+    unique_lock< mutex > lock( peerLock );
+    wait.Record( MetricsNow() - start );
+
+    return( lock );
+}
+
+//------------------------------------------------------------
+// Latency of a message handler, by Handlers key or frame type
+//------------------------------------------------------------
+static Histogram &HandlerLatency( const string &handler ) {
+    return metrics.GetHistogram( "mpc_handler_seconds",
+                                 "handler=\"" + handler + "\"",
+                                 "Time spent in each message handler" );
+}
 
 // Constructor
 // Initializes a peer server listening on the serverHost and serverPort.
@@ -9,7 +31,10 @@ Peer::Peer( string serverhost, int serverport,
             string name = "No Name", int maxpeers = 16, int timeout = 65 ) :
     // variable initialization
     serverHost( serverhost ), serverPort( serverport ), name( name ),
-    maxPeers( maxpeers ), timeOut( timeout )
+    maxPeers( maxpeers ), timeOut( timeout ),
+    connectionPool( REPLY_TIMEOUT ),
+    heartbeat( HEARTBEAT_FAILURES, HEARTBEAT_HISTORY ),
+    heartbeatTimeout( HEARTBEAT_TIMEOUT )
 {
     if ( serverHost.size() < 3 ) {
         // serverHost should be "localhost" or xxx.x.x.x 
@@ -22,7 +47,15 @@ Peer::Peer( string serverhost, int serverport,
     // For a remote Peer, this is often referred to as peerID
     ID = serverHost + ":" + to_string( serverPort );
 
-    routerFunc = NULL;
+    routerFunc    = NULL;
+    Share         = NULL;
+    workerPool    = NULL;
+    workerThreads = 0;
+    workerQueue   = DEFAULT_WORKER_QUEUE;
+    epollFD       = -1;
+    recoveredSecret = 0;
+    peerTable       = make_shared< const PeerTable >();
+    directShares  = false;
             
     Poly = MPC_PolyModule(); // Create local instance of PolyModule
 }
@@ -31,24 +64,33 @@ Peer::Peer( string serverhost, int serverport,
 Peer::~Peer() {
     if ( Share ) { delete Share; }
         
-    if ( CollectedShares.size() ) {
-        map< string, ShareInfo * >::iterator csi;
-        for ( csi = CollectedShares.begin();
-              csi != CollectedShares.end(); ++csi ) {
-            delete csi->second;
-        }
-    }
-    CollectedShares.clear();
+    CollectedShares.Clear();
 }
     
 // Encapsulation Accessor methods
 void Peer::Shutdown() { shutdown = true; }
 
+// Takes effect when MainLoop() starts
+void Peer::SetWorkerPool( int threads, int queue ) {
+    workerThreads = threads;
+    workerQueue   = queue;
+}
+
+//------------------------------------------------------------
+// CheckLivePeers() evicts a peer after failures PINGs in a row
+// get no reply within timeout seconds
+//------------------------------------------------------------
+void Peer::SetHeartbeat( int failures, int timeout ) {
+    heartbeat.SetMaxFailures( failures );
+    heartbeatTimeout = max( timeout, 1 );
+}
+
 //------------------------------------------------------------
 // 
 //------------------------------------------------------------
 void Peer::CreatePeerShare( string shareID, int numcoef, vector<int64> coef,
-                            int64 x, int64 secret, int64 prime ) {
+                            int64 x, int64 secret, int64 prime,
+                            vector<int64> extraSecrets, bool packed ) {
 
     PeerShare *share;
         
@@ -62,74 +104,178 @@ void Peer::CreatePeerShare( string shareID, int numcoef, vector<int64> coef,
         // evaluate it at x, and store the result in f_x
         share = new PeerShare( coef, shareID, numcoef, x, secret, prime );
     }
+
+    if ( extraSecrets.size() and packed ) {
+        // Pack the extra secrets in the secret polynomial
+        share->CreatePackedSecrets( extraSecrets );
+    }
+    else if ( extraSecrets.size() ) {
+        // Share the extra secrets together with secret as a vector share
+        share->CreateSecretVector( extraSecrets );
+    }
         
     Share = share; // Assign to the Peer Share object, destructor deletes
 
     // Create and assign a ShareInfo struct to the CollectedShares
     // Note that f_x is 0
-    ShareInfo *shareInfo = new ShareInfo( shareID, prime, x, share->f_x );
-
-    CollectedShares[ shareID ] = shareInfo;
+    ShareInfo &shareInfo = CollectedShares[ CollectedShares.Intern( shareID ) ];
+    shareInfo = ShareInfo( shareID, prime, x, share->f_x );
+    shareInfo.numSecrets = share->numSecrets;
+    shareInfo.numPacked  = share->numPacked;
 }
     
 //------------------------------------------------------------
 // Call the function pointer in the Handlers map based on
 // the command key (processed as msgType in most functions).
+// A handler that throws, e.g. on a field it cannot parse, is
+// logged, and the request ends as if it had returned.
 //------------------------------------------------------------
 void Peer::CallHandler( const string &command, PeerConnection *pc, string data ) {
     // Get function pointer from Handlers map
     HandlerFunc fp = Handlers[ command ];
 
+    Histogram &latency = HandlerLatency( command );
+    uint64     start   = MetricsNow();
+
     // Call function with PeerConnection (pc) and incoming socket data
-    return (this->*fp)( pc, data );
+    try {
+        (this->*fp)( pc, data );
+    }
+    catch ( const exception &e ) {
+        ErrorMsg( "ERROR: Peer::CallHandler() " + name + " " + command +
+                  " failed: " + e.what() );
+    }
+
+    latency.Record( MetricsNow() - start );
 }
 
 //------------------------------------------------------------
-// This function is run as a thread from the MainLoop() to
+// This function is run on a workerPool thread from MainLoop() to
 // handle a request that came in from another peer on the
 // listening socket.  It is a wrapper for CallHandler() that
 // actually calls the function in the Handlers map. 
+//
+// A text connection (telnet) is one message.  A framed connection
+// from another peer reads every frame already waiting and hands
+// each one, with a copy of its payload, to another worker, which
+// replies with a FRAME_END unless its requestID is 0.  Returning
+// re-arms the socket right away, so the requests multiplexed on
+// one connection run side by side and a slow one does not hold up
+// the next.
+// Returns true if the connection stays open for more requests,
+// false when it should be closed.
 //------------------------------------------------------------
-void Peer::HandlePeer( int client_sock, string host, int port ) {
+bool Peer::HandlePeer( int client_sock, PeerConnection *pc ) {
         
     thread::id threadID = this_thread::get_id();
     ostringstream ostrm;
-    ostrm << "Peer::HandlePeer() New thread ID [" << threadID << "]";
+    ostrm << "Peer::HandlePeer() Worker thread ID [" << threadID << "]";
     DebugMsg( ostrm.str() );
-    DebugMsg( "Peer::HandlePeer() " + name + " Connecting to " + host +
-              " port " + to_string( port ) );
 
-    // Create a PeerConnection object 
-    string None("");
-    PeerConnection PC = PeerConnection( None, host, port, client_sock );
+    if ( not pc->Framed() and not pc->DetectFramed() ) {
+        // Receive message on the client_sock connection
+        string peerMessage = pc->ReceiveData();
+
+        DebugMsg( "Peer::HandlePeer() " + name + " Received: " + peerMessage );
+
+        DispatchMessage( pc, peerMessage );
+
+        DebugMsg( "Peer::HandlePeer() " + name + " Disconnected" );
+        return( false );
+    }
+
+    do {
+        FrameHeader header;
+        if ( not pc->ReceiveFrame( header ) ) {
+            DebugMsg( "Peer::HandlePeer() " + name + " Disconnected" );
+            return( false );
+        }
+
+        // The payload is in the receive buffer, which the next
+        // ReceiveFrame() reuses, so the other worker gets a copy
+        shared_ptr< string > payload =
+            make_shared< string >( pc->Payload().Rest() );
+
+        BeginRequest( client_sock );
+        workerPool->Submit( [ this, client_sock, pc, header, payload ]() {
+                                WireReader reader( payload->data(),
+                                                   payload->size() );
+                                HandleFrame( pc, header, reader );
+                                EndRequest( client_sock );
+                            } );
 
-    // Receive message on the client_sock connection
-    string peerMessage = PC.ReceiveData();
+    } while ( pc->IsOpen() and pc->HasData() );
+
+    return( pc->IsOpen() );
+}
+
+//------------------------------------------------------------
+// Call the handler for one frame received by HandlePeer(), and
+// end its replies with a FRAME_END if the sender waits for them
+//------------------------------------------------------------
+void Peer::HandleFrame( PeerConnection *pc, const FrameHeader &header,
+                        WireReader &payload ) {
 
-    DebugMsg( "Peer::HandlePeer() " + name + " Received: " + peerMessage );
+    PeerConnection::SetReplyID( header.requestID );
+
+    if ( header.type == FRAME_TEXT ) {
+        DispatchMessage( pc, payload.Rest() );
+    }
+    else if ( FrameHandlers.count( header.type ) ) {
+        FrameHandlerFunc fp = FrameHandlers[ header.type ];
+
+        Histogram &latency = HandlerLatency( FrameTypeName( header.type ) );
+        uint64     start   = MetricsNow();
+
+        try {
+            (this->*fp)( pc, payload );
+        }
+        catch ( const exception &e ) {
+            ErrorMsg( "ERROR: Peer::HandleFrame() " + name + " frame type " +
+                      to_string( header.type ) + " failed: " + e.what() );
+        }
+
+        latency.Record( MetricsNow() - start );
+    }
+    else {
+        ErrorMsg( "ERROR: Peer::HandlePeer() " + name + " Failed to find"
+                  " frame type " + to_string( header.type ) +
+                  " in FrameHandlers map." );
+    }
+
+    if ( header.requestID ) {
+        WireWriter end( FRAME_END );
+        pc->SendFrame( end, header.requestID );
+    }
+    PeerConnection::SetReplyID( 0 );
+}
+
+//------------------------------------------------------------
+// Call the handler for a "msgType:msgData" message
+//------------------------------------------------------------
+void Peer::DispatchMessage( PeerConnection *pc, const string &peerMessage ) {
 
     // The message is of the format msgType:msgData
     // where msgType corresponds to a key in the Handlers map
     // Extract the msgType and msgData
     size_t i       = peerMessage.find( ":" );
     string msgType = peerMessage.substr( 0, i );
-    string msgData = peerMessage.substr( i + 1, string::npos );
+    string msgData = i == string::npos ? "" : peerMessage.substr( i + 1 );
         
     // Call the appropriate handler (function) in the Handlers map
     if ( Handlers.count( msgType ) == 0 ) {
         // msgType is not a valid key in the Handlers map
-        ConsoleMsg( "ERROR: Peer::HandlePeer() " + name + " Failed to find"
-                    " msgType " + msgType + " in Handlers map." );
+        metrics.GetCounter( "mpc_unknown_messages_total", "",
+                            "Messages with no handler" ).Add();
+        ErrorMsg( "ERROR: Peer::HandlePeer() " + name + " Failed to find"
+                  " msgType " + msgType + " in Handlers map." );
     }
     else {
         DebugMsg( "Peer::HandlePeer() " + name +
                   " msgType " + msgType + " Call Handler... " );
             
-        CallHandler( msgType, &PC, msgData );
+        CallHandler( msgType, pc, msgData );
     }
-
-    close( client_sock );
-    DebugMsg( "Peer::HandlePeer() " + name + " Disconnected" );
 }
 
 //------------------------------------------------------------
@@ -150,6 +296,7 @@ void Peer::AddRouter( RouterFunc router ) {
 
 //------------------------------------------------------------
 // Adds a peer name and host:port mapping to the known list of peers.
+// The caller holds peerLock.
 //------------------------------------------------------------
 bool Peer::AddPeer( string peerID, string host, int port,
                     string shareID, int64 x ) {
@@ -166,21 +313,60 @@ bool Peer::AddPeer( string peerID, string host, int port,
         ConsoleMsg( "Peer:AddPeer " + name + " Added peerID [" +
                     peerID + "]  host " + host +
                     " port " + to_string( port ) + " " + shareID );
+
+        ClearLagrangeWeights(); // Peers membership changed
+        if ( Share ) { Share->ForgetEvaluations(); }
+        PublishPeers();
     }
     return( addedPeer );
 }
 
 //------------------------------------------------------------
 // Removes peer information from the known list of peers
+// The caller holds peerLock.
 //------------------------------------------------------------
 void Peer::RemovePeer( string peerID ) {
     if ( Peers.count( peerID ) == 1 ) { // peerID in Peers map
         PeerInfo *peerInfo = Peers[ peerID ];
         Peers.erase( peerID );  // erase reference from map
         delete peerInfo;        // free the allocated struct
+
+        connectionPool.Remove( peerID ); // close pooled connections
+        heartbeat.Forget( peerID );
+
+        ClearLagrangeWeights(); // Peers membership changed
+        if ( Share ) { Share->ForgetEvaluations(); }
+        PublishPeers();
     }
 }
 
+//------------------------------------------------------------
+// Publish a new peerTable copy of the Peers map.  The caller
+// holds peerLock, so the copies are published in order.
+//------------------------------------------------------------
+void Peer::PublishPeers() {
+
+    shared_ptr< PeerTable > table = make_shared< PeerTable >();
+
+    map< string, PeerInfo * >::iterator pi;
+    for( pi = Peers.begin(); pi != Peers.end(); ++pi ) {
+        ( *table )[ pi->first ] = *pi->second;
+    }
+
+    atomic_store( &peerTable, shared_ptr< const PeerTable >( table ) );
+}
+
+//------------------------------------------------------------
+// Returns the current peerTable.  The table is never modified,
+// a reader keeps a consistent view of the Peers for as long as
+// it holds the pointer, while AddPeer() and RemovePeer() publish
+// new tables.
+//------------------------------------------------------------
+shared_ptr< const PeerTable > Peer::PeerSnapshot() const {
+
+    return atomic_load( &peerTable );
+}
+
     
 //------------------------------------------------------------
 // Returns whether the maximum limit of names has been added to the
@@ -201,9 +387,9 @@ int Peer::MakeServerSocket( int port, int backlog = 10 ) {
     int sock = GetSocket( port, true );
         
     if ( sock == -1 ) {
-        ConsoleMsg( "ERROR: Peer::MakeServerSocket() " + name +
-                    " GetSocket Failed on port " +
-                    to_string( port ) );
+        ErrorMsg( "ERROR: Peer::MakeServerSocket() " + name +
+                  " GetSocket Failed on port " +
+                  to_string( port ) );
         return( -1 );
     }
 
@@ -238,36 +424,62 @@ vector<string> Peer::SendToPeer( string peerID,
 
     DebugMsg( "Peer::SendToPeer() " + name + " to " +
               peerID + " " + msgType + ":" + msgData );
-        
+
+    WireWriter frame = TextFrame( msgType, msgData );
+
+    return SendToPeer( peerID, frame, waitReply );
+}
+
+//------------------------------------------------------------
+// Send a frame to the identified peer, see SendToPeer() above
+//------------------------------------------------------------
+vector<string> Peer::SendToPeer( string      peerID,
+                                 WireWriter &frame,
+                                 bool        waitReply ) {
+
     vector<string> replyMessages;
+    PeerRoute      route;
         
     if ( routerFunc ) {
-        (this->*routerFunc)( peerID );
+        route = (this->*routerFunc)( peerID );
     }
     else {
-        ConsoleMsg( "ERROR: Peer::SendToPeer() " + name +
-                    " Router Function not available for [" +
-                    msgType + "] to " + peerID );
+        ErrorMsg( "ERROR: Peer::SendToPeer() " + name +
+                  " Router Function not available for frame type " +
+                  to_string( frame.Type() ) + " to " + peerID );
         replyMessages.push_back( "Send Failed" );
         return replyMessages;
     }
 
-    if ( not peerRoute.peerID.size() ) {
-        ConsoleMsg( "ERROR: Peer::SendToPeer() " + name +
-                    "routerFunc() peerID is empty "
-                    "for msgType [" + msgType + "] to " + peerID );
+    if ( not route.peerID.size() ) {
+        ErrorMsg( "ERROR: Peer::SendToPeer() " + name +
+                  "routerFunc() peerID is empty "
+                  "for frame type " + to_string( frame.Type() ) +
+                  " to " + peerID );
         replyMessages.push_back( "Send Failed" );
         return replyMessages;
     }
         
-    // The peerRoute structure is valid, send to that peer
-    replyMessages = ConnectAndSend( peerRoute.host,
-                                    peerRoute.port,
-                                    msgType, msgData,
-                                    peerRoute.peerID,
+    // The route structure is valid, send to that peer
+    replyMessages = ConnectAndSend( route.host,
+                                    route.port,
+                                    frame,
+                                    route.peerID,
                                     waitReply );
     return replyMessages;
 }
+
+//------------------------------------------------------------
+// Returns a FRAME_TEXT frame holding "msgType:msgData"
+//------------------------------------------------------------
+WireWriter Peer::TextFrame( const string &msgType, const string &msgData ) {
+
+    WireWriter frame( FRAME_TEXT, msgType.size() + 1 + msgData.size() );
+    frame.PutBytes( msgType.data(), msgType.size() );
+    frame.PutBytes( ":", 1 );
+    frame.PutBytes( msgData.data(), msgData.size() );
+    return frame;
+}
    
 //------------------------------------------------------------
 // Connects and sends a message to the specified host:port.
@@ -277,53 +489,253 @@ vector<string> Peer::ConnectAndSend( string host, int port,
                                      string msgType, string msgData,
                                      string peerID,
                                      bool waitReply ) {
-    string reply;
+
+    WireWriter frame = TextFrame( msgType, msgData );
+
+    return ConnectAndSend( host, port, frame, peerID, waitReply );
+}
+
+//------------------------------------------------------------
+// Sends a frame to the specified host:port, and returns the
+// text of the reply frames if waitReply.
+//
+// The frame goes over the persistent connection to the peer from
+// connectionPool, keyed by peerID (host:port when peerID is empty),
+// which other threads may be using at the same time.  With
+// waitReply the frame is a request with its own requestID and only
+// the replies to it are returned.  Without waitReply the remote
+// peer sends no replies and this returns once the frame is sent.
+// A connection that the remote peer has since closed is retried
+// once on a new connection.
+//------------------------------------------------------------
+vector<string> Peer::ConnectAndSend( string host, int port,
+                                     WireWriter &frame,
+                                     string peerID,
+                                     bool waitReply ) {
     vector<string> replies;
 
-    // Create a PeerConnection object
-    // client_sock is 0, requesting a new socket for the connection
-    PeerConnection PC = PeerConnection( peerID, host, port, 0 );
+    string poolKey = peerID.size() ? peerID : host + ":" + to_string( port );
+
+    for ( int attempt = 0; attempt < 2; attempt++ ) {
+        bool reused = false;
+        shared_ptr< PeerConnection > pc =
+            connectionPool.Acquire( poolKey, host, port, reused );
+
+        replies.clear();
+        if ( pc->Request( frame, waitReply, replies ) ) {
+            DebugMsg( "Peer::ConnectAndSend() " + name + " sent frame type " +
+                      to_string( frame.Type() ) + " to " + peerID );
+            break;
+        }
+
+        connectionPool.Discard( pc );
+
+        if ( reused and replies.empty() ) {
+            continue; // Stale pooled connection, reconnect
+        }
+        ErrorMsg( "ERROR: Peer::ConnectAndSend() " + name +
+                  " Failed to send frame type " +
+                  to_string( frame.Type() ) + " to " + peerID );
+        break;
+    }
 
-    bool status = PC.SendData( msgType, msgData );
-    if ( status ) {
+    for ( size_t r = 0; r < replies.size(); r++ ) {
         DebugMsg( "Peer::ConnectAndSend() " + name +
-                  " sent " + msgType + " to " + peerID );
+                  " received from [" + peerID +
+                  "]  reply [" + replies[ r ] + "]");
+
+        size_t i = replies[ r ].find( ":" );
+        string replyMsg  = replies[ r ].substr( 0, i );
+        string replyHost = i == string::npos ? "" :
+                           replies[ r ].substr( i + 1, string::npos );
+
+        if ( replyHost.size() < 6 ) {
+            // This can't be a valid host string (host:port)
+            ErrorMsg( "ERROR: Peer::ConnectAndSend() " + name +
+                      " replyMsg [" + replyMsg +
+                      "]  replyHost [" + replyHost + "]  size:" +
+                      to_string( replyHost.size() ) +
+                      " is to small to be valid host:port" );
+        }
     }
-    else {
-        ConsoleMsg( "ERROR: Peer::ConnectAndSend() " + name +
-                    " Failed to send " + msgType + " to " + peerID );
-    }
-
-    if ( waitReply ) {
-        reply = PC.ReceiveData();
-
-        while ( reply != "None" ) {
-            replies.push_back( reply );
-                
-            DebugMsg( "Peer::ConnectAndSend() " + name +
-                      " received from [" + peerID +
-                      "]  reply [" + reply + "]");
-
-            size_t i = reply.find( ":" );
-            string replyMsg  = reply.substr( 0, i );
-            string replyHost = reply.substr( i + 1, string::npos );
-
-            if ( replyHost.size() < 6 ) {
-                // This can't be a valid host string (host:port)
-                ConsoleMsg( "ERROR: Peer::ConnectAndSend() " + name +
-                            " replyMsg [" + replyMsg +
-                            "]  replyHost [" + replyHost + "]  size:" +
-                            to_string( replyHost.size() ) +
-                            " is to small to be valid host:port" );
-                break;
+
+    return( replies );
+}
+
+//------------------------------------------------------------
+// Sends frame to every peer in routes at once, and waits for each
+// to acknowledge it with its FRAME_END.  The requests are all sent
+// before any reply is read, so a round costs about the slowest
+// peers round trip rather than the sum of them, without a thread
+// per peer.  The peerIDs that could not be reached or did not
+// acknowledge are returned in failed, and the text replies of
+// each peer in replies, in the order of routes.  Every peer must
+// reply within timeoutMs of its own send, REPLY_TIMEOUT seconds
+// when timeoutMs is -1.  A peer with no pooled connection is
+// connected first, for at most timeoutMs, and fails if it does not
+// connect.  The connections of all peers still
+// waited for are polled together and each reply is taken when it
+// arrives, so a peer that never answers delays no other peer, and
+// rttMs returns the milliseconds from each send to the arrival
+// of its replies, -1 for a peer that failed.
+//
+// Returns the number of peers that acknowledged the frame.
+//------------------------------------------------------------
+size_t Peer::SendToPeers( const vector< PeerRoute > &routes,
+                          WireWriter &frame,
+                          vector< string > &failed,
+                          vector< vector< string > > *replies,
+                          int timeoutMs,
+                          vector< double > *rttMs ) {
+
+    vector< WireWriter * > frames( routes.size(), &frame );
+
+    return SendToPeers( routes, frames, failed, replies, timeoutMs, rttMs );
+}
+
+//------------------------------------------------------------
+// SendToPeers() with a frame for each peer, frames[ r ] is sent
+// to routes[ r ]
+//------------------------------------------------------------
+size_t Peer::SendToPeers( const vector< PeerRoute > &routes,
+                          const vector< WireWriter * > &frames,
+                          vector< string > &failed,
+                          vector< vector< string > > *replies,
+                          int timeoutMs,
+                          vector< double > *rttMs ) {
+
+    typedef chrono::steady_clock Clock;
+
+    if ( replies ) {
+        replies->assign( routes.size(), vector< string >() );
+    }
+    if ( rttMs ) {
+        rttMs->assign( routes.size(), -1 );
+    }
+    Clock::duration timeout = chrono::milliseconds(
+        timeoutMs >= 0 ? timeoutMs : REPLY_TIMEOUT * 1000 );
+    vector< Clock::time_point > sendTime( routes.size() );
+
+    vector< shared_ptr< PeerConnection > > connections( routes.size() );
+    vector< uint64 > requestIDs( routes.size(), 0 );
+    vector< bool >   sent( routes.size(), false );
+
+    // Send to every peer
+    for ( size_t r = 0; r < routes.size(); r++ ) {
+        const PeerRoute &route = routes[ r ];
+
+        for ( int attempt = 0; attempt < 2 and not sent[ r ]; attempt++ ) {
+            // A new connection gets the reply timeout to connect, so
+            // a peer that drops the SYN fails like one that never replies
+            bool reused = false;
+            connections[ r ] = connectionPool.Acquire(
+                route.peerID, route.host, route.port, reused,
+                (int)chrono::duration_cast< chrono::milliseconds >
+                     ( timeout ).count() );
+            sendTime[ r ] = Clock::now();
+
+            sent[ r ] = connections[ r ]->SendRequest( *frames[ r ], true,
+                                                       requestIDs[ r ] );
+            if ( not sent[ r ] ) {
+                connectionPool.Discard( connections[ r ] );
+                if ( not reused ) {
+                    break; // A new connection failed, don't retry
+                }
             }
+        }
+    }
+
+    // Then collect the acknowledgements, as they arrive
+    size_t           acknowledged = 0;
+    vector< size_t > waitingFor;  // Routes with no FRAME_END yet
 
-            reply = PC.ReceiveData();
+    for ( size_t r = 0; r < routes.size(); r++ ) {
+        if ( sent[ r ] ) {
+            waitingFor.push_back( r );
+        }
+        else {
+            ErrorMsg( "ERROR: Peer::SendToPeers() " + name +
+                      " Failed to send frame type " +
+                      to_string( frames[ r ]->Type() ) + " to " +
+                      routes[ r ].peerID );
+            failed.push_back( routes[ r ].peerID );
         }
-        PC.Close();
     }
 
-    return( replies );
+    bool readable = false; // The last poll() found replies to read
+
+    while ( waitingFor.size() ) {
+        vector< size_t >        stillWaiting;
+        vector< struct pollfd > sockets;
+        Clock::time_point       nextDeadline = Clock::time_point::max();
+
+        for ( size_t w = 0; w < waitingFor.size(); w++ ) {
+            size_t           r = waitingFor[ w ];
+            vector< string > peerReplies;
+
+            // Take what has arrived before looking at the deadline
+            PeerConnection::ReplyState state =
+                connections[ r ]->PollReplies( requestIDs[ r ], peerReplies );
+            Clock::time_point now = Clock::now();
+
+            if ( state == PeerConnection::REPLY_ENDED ) {
+                if ( replies ) {
+                    ( *replies )[ r ].swap( peerReplies );
+                }
+                if ( rttMs ) {
+                    ( *rttMs )[ r ] = chrono::duration< double, milli >
+                                      ( now - sendTime[ r ] ).count();
+                }
+                acknowledged++;
+                continue;
+            }
+            if ( state == PeerConnection::REPLY_PENDING and
+                 now < sendTime[ r ] + timeout ) {
+                stillWaiting.push_back( r );
+                nextDeadline = min( nextDeadline, sendTime[ r ] + timeout );
+
+                struct pollfd pfd;
+                pfd.fd      = connections[ r ]->Socket();
+                pfd.events  = POLLIN;
+                pfd.revents = 0;
+                sockets.push_back( pfd );
+                continue;
+            }
+
+            if ( state == PeerConnection::REPLY_PENDING ) {
+                // Timed out, the connection may still be good
+                connections[ r ]->DropReplies( requestIDs[ r ], peerReplies );
+            }
+            else {
+                connectionPool.Discard( connections[ r ] );
+            }
+            ErrorMsg( "ERROR: Peer::SendToPeers() " + name +
+                      " Failed to send frame type " +
+                      to_string( frames[ r ]->Type() ) + " to " +
+                      routes[ r ].peerID );
+            failed.push_back( routes[ r ].peerID );
+        }
+
+        bool progress = stillWaiting.size() < waitingFor.size();
+        waitingFor.swap( stillWaiting );
+        if ( waitingFor.empty() ) {
+            break;
+        }
+
+        // Replies to read that PollReplies() left: another thread is
+        // reading a shared connection, give it time to hand them over
+        if ( readable and not progress ) {
+            this_thread::sleep_for( chrono::microseconds( 100 ) );
+        }
+
+        // Sleep until a reply arrives or the next peer times out
+        int waitMs = (int)chrono::duration_cast< chrono::milliseconds >
+                     ( nextDeadline - Clock::now() ).count() + 1;
+
+        readable = poll( sockets.data(), sockets.size(), waitMs ) > 0;
+    }
+
+    return( acknowledged );
 }
 
 //------------------------------------------------------------
@@ -354,41 +766,64 @@ void Peer::RunStabilizer( int delay ) {
     
 //------------------------------------------------------------
 // Attempts to ping all currently known peers to ensure that
-// they are still active. Removes any from the peer list that do
-// not reply. This function can be used as a simple stabilizer.
+// they are still active. This function can be used as a simple
+// stabilizer.
+//
+// The Peers are taken from the peerTable and all PINGed at once over
+// their pooled connections.  Each peer has heartbeatTimeout seconds
+// from its own PING to reply, see SendToPeers().  The result of
+// every PING is recorded
+// in heartbeat, and a peer is only removed once it has failed
+// heartbeat's limit of PINGs in a row.
 //------------------------------------------------------------
 void Peer::CheckLivePeers() {
 
     DebugMsg( "Peer::CheckLivePeers " + name );
 
+    vector< PeerRoute > routes;
+
+    shared_ptr< const PeerTable > peers = PeerSnapshot();
+
+    PeerTable::const_iterator pi; // Peers map iterator
+    for( pi = peers->begin(); pi != peers->end(); ++pi ) {
+        routes.push_back( PeerRoute( pi->first, pi->second.host,
+                                     pi->second.port ) );
+    }
+
+    ConsoleMsg( "Peer::CheckLivePeers " + name + " checking " +
+                to_string( routes.size() ) + " Peers" );
+
+    WireWriter ping = TextFrame( "PING", "" );
+
+    vector< string >           failed;
+    vector< vector< string > > replies;
+    vector< double >           rttMs;
+    SendToPeers( routes, ping, failed, &replies,
+                 heartbeatTimeout * 1000, &rttMs );
+
     vector<string> toDelete;
-        
-    map< string, PeerInfo * >::iterator pi; // Peers map iterator
 
-    for( pi = Peers.begin(); pi != Peers.end(); ++pi ) {
-        string peerID      = pi->first;
-        PeerInfo *peerInfo = pi->second;
-
-        ConsoleMsg( "Peer::CheckLivePeers " + name +
-                    " checking " + peerID );
-
-        // Create a PeerConnection object
-        // client_sock is 0, requesting a new socket for the connection
-        PeerConnection PC = PeerConnection( peerID,
-                                            peerInfo->host,
-                                            peerInfo->port, 0 );
-
-        if ( not PC.SendData( "PING", "" ) ) {
-            ConsoleMsg( "ERROR: Peer::CheckLivePeers() " + name +
-                        " PING SendData Failed to " + peerInfo->host + ":" +
-                        to_string( peerInfo->port ) );
-            toDelete.push_back( peerID );
+    for ( size_t r = 0; r < routes.size(); r++ ) {
+        bool   replied = rttMs[ r ] >= 0 and replies[ r ].size();
+        string peer    = "peer=\"" + routes[ r ].peerID + "\"";
+
+        if ( not replied ) {
+            ErrorMsg( "ERROR: Peer::CheckLivePeers() " + name +
+                      " PING Failed to " + routes[ r ].host + ":" +
+                      to_string( routes[ r ].port ) );
+            metrics.GetCounter( "mpc_heartbeat_failures_total", peer,
+                                "CheckLivePeers() PINGs with no reply" ).Add();
         }
         else {
-            string reply = PC.ReceiveData();
             DebugMsg( "Peer::CheckLivePeers() " + name +
-                      " Received: " + reply );
-            PC.Close();
+                      " Received: " + replies[ r ][0] );
+            metrics.GetHistogram( "mpc_heartbeat_rtt_seconds", peer,
+                                  "CheckLivePeers() PING round trips" )
+                .Record( (uint64)( rttMs[ r ] * 1e6 ) );
+        }
+
+        if ( heartbeat.Record( routes[ r ].peerID, replied, rttMs[ r ] ) ) {
+            toDelete.push_back( routes[ r ].peerID );
         }
     }
         
@@ -396,12 +831,11 @@ void Peer::CheckLivePeers() {
                 to_string( toDelete.size() ) + " Peers to delete" );
         
     // Now delete all Peers that didn't respond from the Peers map
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<<<<<<
+    unique_lock< mutex > lock = LockPeers(); // Write Peers
     vector<string>::iterator vi;
     for( vi = toDelete.begin(); vi != toDelete.end(); ++vi ) {
         RemovePeer( *vi );
     }
-    peerLock.unlock(); // Critical Section Unlock >>>>>>>>>>>>>>>>>
 }    
     
 //------------------------------------------------------------
@@ -413,87 +847,179 @@ void Peer::StartMainLoop() {
 }
     
 //------------------------------------------------------------
+// Server listening main loop for this peer.
+//
+// A single epoll reactor waits on the non-blocking listening
+// socket and on every accepted client socket.  New connections
+// are accepted and registered until accept() would block.  When a
+// client socket has a request to read, HandlePeer() is submitted to
+// the workerPool, so at most workerPool->NumThreads() requests are
+// handled at once and no thread is created per connection.  Client
+// sockets are registered EPOLLONESHOT, so a socket gets no more
+// events while a worker owns it; FinishClient() re-arms a framed
+// connection for its next request, or closes it.
 //
+// When workerQueue requests are already waiting, Submit() blocks
+// the reactor until a worker is free and new requests queue up in
+// the kernel.  Connections idle for timeOut seconds are closed.
 //------------------------------------------------------------
 void Peer::MainLoop() {
         
     DebugMsg( "Peer::MainLoop" + name );
         
-    int listen_sock = MakeServerSocket( serverPort );
-        
+    // Requests held back by a full workerPool wait in the kernel
+    // listen queue, so ask for the longest one
+    int listen_sock = MakeServerSocket( serverPort, SOMAXCONN );
+
+    if ( listen_sock < 0 ) {
+        ErrorMsg( "ERROR: Peer::MainLoop " + name +
+                  " no listening socket" );
+        return;
+    }
+
     //-------------------------------------------------------
-    // Set a non-blocking timeout of timeOut seconds
-    struct timeval timeout;      
-    timeout.tv_sec  = timeOut;
-    timeout.tv_usec = 0;
-        
-    int status = setsockopt( listen_sock,
-                             SOL_SOCKET,
-                             SO_RCVTIMEO,
-                             (char *)&timeout,
-                             sizeof(timeout) );
-    if ( status < 0) {
-        cerr << "Peer::MainLoop setsockopt SO_RCVTIMEO failed "
+    // Non-blocking listening socket in an epoll set
+    int flags = fcntl( listen_sock, F_GETFL, 0 );
+    if ( fcntl( listen_sock, F_SETFL, flags | O_NONBLOCK ) < 0 ) {
+        cerr << "Peer::MainLoop fcntl O_NONBLOCK failed "
+             << strerror( errno ) << endl;
+        shutdown = true;
+    }
+
+    epollFD = epoll_create1( 0 );
+    if ( epollFD < 0 ) {
+        cerr << "Peer::MainLoop epoll_create1 failed "
+             << strerror( errno ) << endl;
+        close( listen_sock );
+        return;
+    }
+
+    struct epoll_event event;
+    event.events  = EPOLLIN;
+    event.data.fd = listen_sock;
+    if ( epoll_ctl( epollFD, EPOLL_CTL_ADD, listen_sock, &event ) < 0 ) {
+        cerr << "Peer::MainLoop epoll_ctl listening socket failed "
              << strerror( errno ) << endl;
         shutdown = true;
     }
-    // Do we need to set a timeout on send? -> SO_SNDTIMEO
+
+    size_t numThreads = workerThreads;
+    if ( workerThreads < 1 ) {
+        numThreads = max( (size_t)MIN_WORKER_THREADS,
+                          (size_t)thread::hardware_concurrency() );
+    }
+    workerPool = new WorkerPool( numThreads, max( workerQueue, 1 ) );
+
+    ConsoleMsg( "Peer::MainLoop " + name + " listening with " +
+                to_string( workerPool->NumThreads() ) + " worker threads" +
+                " queue " + to_string( max( workerQueue, 1 ) ) );
+
+    vector< struct epoll_event > events( MAX_EPOLL_EVENTS );
         
     //-------------------------------------------------------
     // Server listening main loop for this peer
-        
+    // epoll_wait() returns at least every timeOut seconds so that
+    // shutdown is seen and idle clients are closed
     while ( not shutdown ) {
         DebugMsg( "Peer::MainLoop " + name +
                   " Listening for connections..." );
-            
-        struct sockaddr_in in_address;
-        int addrlen = sizeof( in_address );
-
-        // Wait for incoming connections
-        // The accept() system call is used with connection-based socket
-        // types (SOCK_STREAM, SOCK_SEQPACKET).  It extracts the first
-        // connection request on the queue of pending connections for
-        // the listening socket, creates a new connected socket, and
-        // returns a new file descriptor referring to that socket.
-        // The newly created socket is not in the listening state.
-        int client_sock = accept( listen_sock,
-                                  (struct sockaddr *)&in_address,
-                                  (socklen_t *)&addrlen);
-        if ( client_sock == -1 ) {
-            // Timed out... Loop back and call accept again
-            // This is intended to allow shutdown to be activated.
-            // But if CheckLivePeers() is running and there are other
-            // peers on the network, then the above accept will be
-            // returning at the interval of the stabilizer
-            continue;
-        }
-        else if ( client_sock < 0 ) {
-            cerr << "Peer::MainLoop accept error "
+
+        int numEvents = epoll_wait( epollFD, events.data(),
+                                    (int)events.size(), timeOut * 1000 );
+        if ( numEvents < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            cerr << "Peer::MainLoop epoll_wait error "
                  << strerror( errno ) << endl;
             shutdown = true;
+            break;
         }
 
-        string client_host = inet_ntoa( in_address.sin_addr );
-        int    client_port = ntohs    ( in_address.sin_port );
-            
-        // Inform user of socket number used in send and receive commands
-        ConsoleMsg( "Peer::MainLoop " + name +
-                    " New client connection on socket " +
-                    to_string( client_sock ) + " host: " + client_host +
-                    " port: " + to_string( client_port ) );
-
-        // Create handler thread for the client request via lambda func
-        // encapsulating the HandlePeer() function
-        thread handler_thread( [ this,
-                                 client_sock,
-                                 client_host,
-                                 client_port ]() {
-                                   HandlePeer( client_sock,
-                                               client_host,
-                                               client_port );
-                               } );
-
-        handler_thread.detach();
+        for ( int e = 0; e < numEvents; e++ ) {
+            int fd = events[ e ].data.fd;
+
+            if ( fd == listen_sock ) {
+                // Accept every pending connection
+                while ( true ) {
+                    struct sockaddr_in in_address;
+                    socklen_t addrlen = sizeof( in_address );
+
+                    int client_sock = accept( listen_sock,
+                                              (struct sockaddr *)&in_address,
+                                              &addrlen );
+                    if ( client_sock < 0 ) {
+                        if ( errno != EAGAIN and errno != EWOULDBLOCK and
+                             errno != EINTR ) {
+                            cerr << "Peer::MainLoop accept error "
+                                 << strerror( errno ) << endl;
+                        }
+                        break;
+                    }
+
+                    string client_host = inet_ntoa( in_address.sin_addr );
+                    int    client_port = ntohs    ( in_address.sin_port );
+
+                    // Inform user of socket number used in send
+                    // and receive commands
+                    ConsoleMsg( "Peer::MainLoop " + name +
+                                " New client connection on socket " +
+                                to_string( client_sock ) +
+                                " host: " + client_host +
+                                " port: " + to_string( client_port ) );
+
+                    ClientInfo client;
+                    client.pc     = new PeerConnection( "", client_host,
+                                                        client_port,
+                                                        client_sock );
+                    client.active   = time( NULL );
+                    client.busy     = false;
+                    client.inFlight = 0;
+                    client.closing  = false;
+
+                    lock_guard< mutex > lock( clientLock );
+
+                    struct epoll_event client_event;
+                    client_event.events  = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                    client_event.data.fd = client_sock;
+                    if ( epoll_ctl( epollFD, EPOLL_CTL_ADD,
+                                    client_sock, &client_event ) < 0 ) {
+                        ErrorMsg( "ERROR: Peer::MainLoop " + name +
+                                  " epoll_ctl failed on socket " +
+                                  to_string( client_sock ) + " " +
+                                  strerror( errno ) );
+                        client.pc->Close();
+                        delete client.pc;
+                        continue;
+                    }
+                    clients[ client_sock ] = client;
+                }
+                continue;
+            }
+
+            // A client request is ready to read.  The socket is
+            // disarmed until FinishClient(), so only this worker
+            // reads it.
+            PeerConnection *pc = NULL;
+
+            clientLock.lock();
+            if ( clients.count( fd ) ) {
+                clients[ fd ].busy = true;
+                pc = clients[ fd ].pc;
+            }
+            clientLock.unlock();
+
+            if ( not pc ) {
+                continue;
+            }
+
+            workerPool->Submit( [ this, fd, pc ]() {
+                                    bool keepOpen = HandlePeer( fd, pc );
+                                    FinishClient( fd, keepOpen );
+                                } );
+        }
+
+        CloseIdleClients();
             
     } // while ( not shutdown )
 
@@ -509,51 +1035,326 @@ void Peer::MainLoop() {
     // "https://stackoverflow.com/questions/4250013/"
     // "is-destructor-called-if-sigint-or-sigstp-issued"
         
+    // Finish the requests already handed to the workers
+    delete workerPool;
+    workerPool = NULL;
+
+    clientLock.lock();
+    map< int, ClientInfo >::iterator ci;
+    for ( ci = clients.begin(); ci != clients.end(); ++ci ) {
+        ci->second.pc->Close();
+        delete ci->second.pc;
+    }
+    clients.clear();
+    clientLock.unlock();
+
+    close( epollFD );
     close( listen_sock );
+}
+
+//------------------------------------------------------------
+// Called on the worker thread when HandlePeer() returns.  A
+// framed connection is re-armed in epoll for its next request,
+// any other connection is closed, or by EndRequest() once the
+// requests it handed to other workers are done.
+//------------------------------------------------------------
+void Peer::FinishClient( int client_sock, bool keepOpen ) {
+
+    lock_guard< mutex > lock( clientLock );
+
+    if ( clients.count( client_sock ) == 0 ) {
+        return;
+    }
+    ClientInfo &client = clients[ client_sock ];
+
+    client.busy   = false;
+    client.active = time( NULL );
+
+    if ( keepOpen ) {
+        struct epoll_event client_event;
+        client_event.events  = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        client_event.data.fd = client_sock;
+        if ( epoll_ctl( epollFD, EPOLL_CTL_MOD,
+                        client_sock, &client_event ) == 0 ) {
+            return;
+        }
+    }
+
+    if ( client.inFlight ) {
+        client.closing = true;
+        return;
+    }
+
+    client.pc->Close();
+    delete client.pc;
+    clients.erase( client_sock );
+}
+
+//------------------------------------------------------------
+// Count a request of client_sock handed to another worker, the
+// connection is not closed until EndRequest()
+//------------------------------------------------------------
+void Peer::BeginRequest( int client_sock ) {
+
+    lock_guard< mutex > lock( clientLock );
+
+    if ( clients.count( client_sock ) ) {
+        clients[ client_sock ].inFlight++;
+    }
+}
+
+//------------------------------------------------------------
+// A request from BeginRequest() is done, close the connection
+// if FinishClient() was waiting for it
+//------------------------------------------------------------
+void Peer::EndRequest( int client_sock ) {
+
+    lock_guard< mutex > lock( clientLock );
+
+    if ( clients.count( client_sock ) == 0 ) {
+        return;
+    }
+    ClientInfo &client = clients[ client_sock ];
+
+    client.inFlight--;
+    client.active = time( NULL );
+
+    if ( client.closing and client.inFlight == 0 ) {
+        client.pc->Close();
+        delete client.pc;
+        clients.erase( client_sock );
+    }
+}
+
+//------------------------------------------------------------
+// Close client connections that no worker is using and that
+// have been idle for more than timeOut seconds
+//------------------------------------------------------------
+void Peer::CloseIdleClients() {
+
+    time_t now = time( NULL );
+
+    lock_guard< mutex > lock( clientLock );
+
+    map< int, ClientInfo >::iterator ci;
+    for ( ci = clients.begin(); ci != clients.end(); ) {
+        if ( not ci->second.busy and ci->second.inFlight == 0 and
+             now - ci->second.active > timeOut ) {
+            DebugMsg( "Peer::CloseIdleClients " + name +
+                      " closing idle socket " + to_string( ci->first ) );
+            ci->second.pc->Close();
+            delete ci->second.pc;
+            ci = clients.erase( ci );
+        }
+        else {
+            ++ci;
+        }
+    }
 }  
 
 //------------------------------------------------------------
-// 
+// Returns the Lagrange basis weights at x = at (0 for a secret)
+// for the sorted x values x_vec.  The weights depend only on the
+// set of x values, which only changes with Peers membership, so
+// they are computed once and kept in the lagrangeWeights cache.
+// Up to LAGRANGE_WEIGHTS_LIMIT sets are kept, a packed share takes
+// one for each of its secrets.  Returns no weights, and keeps
+// none, if an x is repeated mod prime.
+//------------------------------------------------------------
+vector<int64> Peer::LagrangeWeights( const vector<int64> &x_vec,
+                                     int64 prime, int64 at ) {
+
+    WeightKey key( prime, at, x_vec );
+
+    {
+        lock_guard< mutex > lock( weightLock );
+
+        map< WeightKey, vector<int64> >::iterator wi;
+        wi = lagrangeWeights.find( key );
+        if ( wi != lagrangeWeights.end() ) {
+            return wi->second;
+        }
+    }
+
+    // Not cached, compute outside the lock
+    vector<int64> weights = Poly.LagrangeWeights( x_vec, prime, at );
+
+    if ( weights.size() != x_vec.size() ) {
+        ErrorMsg( "ERROR: Peer::LagrangeWeights " + name + " the " +
+                  to_string( x_vec.size() ) + " x values are not distinct"
+                  " mod prime " + to_string( prime ) );
+        return vector<int64>();
+    }
+
+    DebugMsg( "Peer::LagrangeWeights " + name + " computed weights for " +
+              to_string( x_vec.size() ) + " points" );
+
+    lock_guard< mutex > lock( weightLock );
+    if ( lagrangeWeights.size() >= LAGRANGE_WEIGHTS_LIMIT ) {
+        lagrangeWeights.clear();
+    }
+    lagrangeWeights[ key ] = weights;
+
+    return weights;
+}
+
 //------------------------------------------------------------
-void Peer::LagrangeInterpolate( vector<int64> x_vec,
+// Empty the lagrangeWeights cache
+//------------------------------------------------------------
+void Peer::ClearLagrangeWeights() {
+    lock_guard< mutex > lock( weightLock );
+    lagrangeWeights.clear();
+}
+
+//------------------------------------------------------------
+// Recover the polynomial value at x = 0 from the x_vec, f_x_vec
+// pairs by Lagrange interpolation in the field of prime.
+// The result is returned in recovered and stored in recoveredSecret.
+// Returns false, recovering nothing, if an x is repeated.
+//
+// With the cached basis weights this is a dot product:
+// f(0) = Σ w_i * f(x_i)
+//------------------------------------------------------------
+bool Peer::LagrangeInterpolate( vector<int64> x_vec,
                                 vector<int64> f_x_vec,
-                                int64 prime ) {
-        
-    int64 recoveredValue = 0;
-    vector<int64>::size_type i;
-    vector<int64>::size_type j;
-	
-    for( i = 0; i < x_vec.size(); i++ ){
-        // Multiply numerators across the top and denominators
-        // across the bottom for Lagrange interpolation
-        // Π[ (x_i % Z) / (( x_i - x_j ) % Z) ]
-        int64 numerator   = 1;
-        int64 denominator = 1;
-	    
-        for( j = 0; j < x_vec.size(); j++ ) {
-            if( i == j ) {
-                continue; // The same share
-            }
+                                int64 prime, int64 &recovered ) {
 
-            // Get values of x from the i,j share pair
-            int64 x_i = x_vec[ i ];
-            int64 x_j = x_vec[ j ];
-		
-            numerator   = Poly.Modulus( numerator * -x_j, prime );
-            denominator = Poly.Modulus( denominator * (x_i - x_j), prime );
+    // The cache is keyed by sorted x values, sort the pairs if needed
+    if ( not is_sorted( x_vec.begin(), x_vec.end() ) ) {
+        vector< pair< int64, int64 > > points;
+        for( size_t i = 0; i < x_vec.size(); i++ ) {
+            points.push_back( make_pair( x_vec[ i ], f_x_vec[ i ] ) );
         }
+        sort( points.begin(), points.end() );
+        for( size_t i = 0; i < points.size(); i++ ) {
+            x_vec  [ i ] = points[ i ].first;
+            f_x_vec[ i ] = points[ i ].second;
+        }
+    }
 
-        // Sum values of { Z + f(x) * Π[ x_i / ( x_i - x_j ) ] } % Z
-        int64 f_x_i  = f_x_vec[ i ];
-        int64 modInv = Poly.ModInverse( denominator, prime );
+    vector<int64> weights = LagrangeWeights( x_vec, prime );
+    if ( weights.empty() and x_vec.size() ) {
+        return false;
+    }
 
-        recoveredValue = Poly.Modulus(
-            ( prime + recoveredValue + f_x_i * numerator * modInv ),
-            prime );
-    } 
+    int64 recoveredValue = FieldDispatch( prime, [&]( const auto &F ) {
+        int64 sum = 0;
+        for( size_t i = 0; i < weights.size(); i++ ) {
+            sum = F.Add( sum, F.Mul( weights[ i ], F.Reduce( f_x_vec[ i ] ) ) );
+        }
+        return sum;
+    } );
 
     recoveredSecret = recoveredValue;
 
     DebugMsg( "Peer::LagrangeInterp() " + name + " Recovered secret: " +
               to_string( recoveredValue ) );
+
+    recovered = recoveredValue;
+    return true;
+}
+
+//------------------------------------------------------------
+// Recover numValues polynomial values at x = 0 that were all
+// evaluated at the same sorted x values x_vec, in one pass.
+//
+// f_x_mat is in structure-of-arrays layout, one row per x:
+//   f_x_mat[ i * numValues + v ] is value v evaluated at x_vec[ i ]
+// so the inner loop runs over contiguous values with a single
+// basis weight.  Returns the numValues recovered values, or none
+// if an x is repeated.
+//------------------------------------------------------------
+vector<int64> Peer::LagrangeInterpolateBatch( const vector<int64> &x_vec,
+                                              const vector<int64> &f_x_mat,
+                                              size_t numValues,
+                                              int64  prime ) {
+
+    if ( f_x_mat.size() != x_vec.size() * numValues ) {
+        throw( runtime_error( "LagrangeInterpolateBatch() "
+                              "f_x_mat must be x_vec.size() * numValues" ));
+    }
+
+    vector<int64> weights = LagrangeWeights( x_vec, prime );
+    if ( weights.empty() and x_vec.size() ) {
+        return vector<int64>();
+    }
+
+    return FieldDispatch( prime, [&]( const auto &F ) {
+        vector<int64> recovered( numValues, 0 );
+        int64        *r = recovered.data();
+
+        for( size_t i = 0; i < x_vec.size(); i++ ) {
+            const int64 *row = f_x_mat.data() + i * numValues;
+            int64        w   = weights[ i ];
+
+            for( size_t v = 0; v < numValues; v++ ) {
+                r[ v ] = F.Add( r[ v ], F.Mul( w, F.Reduce( row[ v ] ) ) );
+            }
+        }
+        return recovered;
+    } );
+}
+
+//------------------------------------------------------------
+// True if x is one of the points -j, j < numPacked, where the
+// secrets of a packed share are embedded.  The value there is a
+// secret, and Lagrange weights at -j are not defined for it.
+//------------------------------------------------------------
+bool Peer::PackedSecretPoint( int64 x, size_t numPacked, int64 prime ) {
+
+    int64 r = x % prime;
+    if ( r < 0 ) {
+        r += prime;
+    }
+    // -j mod prime is prime - j, and 0 for j = 0
+    return r == 0 or ( (uint64)( prime - r ) < numPacked );
+}
+
+//------------------------------------------------------------
+// Recover the numPacked secrets of a packed share from the
+// x_vec, f_x_vec pairs.  Packed secret j is the polynomial value
+// at x = -j (see PeerShare::CreateSecretPolynomial), so this
+// interpolates at 0, -1, ... -(numPacked-1), one cached set of
+// basis weights per point.  Returns no values if an x is one of
+// those points or is repeated.  The caller checks there are enough
+// points.
+//------------------------------------------------------------
+vector<int64> Peer::LagrangeInterpolatePacked( const vector<int64> &x_vec,
+                                               const vector<int64> &f_x_vec,
+                                               size_t numPacked,
+                                               int64  prime ) {
+
+    for( size_t i = 0; i < x_vec.size(); i++ ) {
+        if ( PackedSecretPoint( x_vec[ i ], numPacked, prime ) ) {
+            ErrorMsg( "ERROR: Peer::LagrangeInterpolatePacked() " + name +
+                      " x " + to_string( x_vec[ i ] ) +
+                      " is a packed secret point" );
+            return vector<int64>();
+        }
+    }
+
+    vector< vector<int64> > weights( numPacked );
+    for( size_t j = 0; j < numPacked; j++ ) {
+        weights[ j ] = LagrangeWeights( x_vec, prime, -(int64)j );
+        if ( weights[ j ].empty() and x_vec.size() ) {
+            return vector<int64>();
+        }
+    }
+
+    return FieldDispatch( prime, [&]( const auto &F ) {
+        vector<int64> f_x_P( f_x_vec.size() );
+        vector<int64> recovered( numPacked, 0 );
+
+        for( size_t i = 0; i < f_x_vec.size(); i++ ) {
+            f_x_P[ i ] = F.Reduce( f_x_vec[ i ] );
+        }
+
+        for( size_t j = 0; j < numPacked; j++ ) {
+            for( size_t i = 0; i < f_x_P.size(); i++ ) {
+                recovered[ j ] = F.Add( recovered[ j ],
+                                        F.Mul( weights[ j ][ i ], f_x_P[ i ] ) );
+            }
+        }
+        return recovered;
+    } );
 }
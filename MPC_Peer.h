@@ -8,6 +8,18 @@
 #include "MPC_PeerCommon.h"
 #include "MPC_PeerConnection.h"
 #include "MPC_PeerShare.h"
+#include "MPC_WorkerPool.h"
+#include "MPC_ConnectionPool.h"
+#include "MPC_Heartbeat.h"
+#include "MPC_ShareStore.h"
+#include "MPC_Metrics.h"
+
+#include <sys/epoll.h>  // epoll_create1, epoll_ctl, epoll_wait
+#include <fcntl.h>      // fcntl O_NONBLOCK
+#include <poll.h>       // poll, SendToPeers() replies
+#include <tuple>
+#include <memory>       // shared_ptr of the peerTable snapshot
+#include <chrono>       // steady_clock for PING round trips
 
 using namespace std;
 
@@ -16,10 +28,25 @@ using namespace std;
 class Peer;
 typedef void (Peer::*HandlerFunc)( PeerConnection *, string );
 
+// Function pointer typedef for handler functions of binary frames
+// set into Peer::FrameHandlers map
+typedef void (Peer::*FrameHandlerFunc)( PeerConnection *, WireReader & );
+
 // Function pointer typedef for Router function that
-// populates a PeerRoute struct for where to send a message
+// returns a PeerRoute struct for where to send a message
 class MPC_Peer;
-typedef void (Peer::*RouterFunc)( string peerID );
+typedef PeerRoute (Peer::*RouterFunc)( string peerID );
+
+//------------------------------------------------------------
+// A connection accepted by Peer::MainLoop()
+//------------------------------------------------------------
+struct ClientInfo {
+    PeerConnection *pc;
+    time_t          active; // Time of the last request
+    bool            busy;   // A worker is reading requests
+    int             inFlight; // Requests handed to other workers
+    bool            closing;  // Close when inFlight reaches 0
+};
 
 //------------------------------------------------------------
 //
@@ -39,32 +66,81 @@ protected:
     int  timeOut;          // timeout for MainLoop listening socket
 
     // Map of Peers that this peer is currently able to connect
-    // [ ID ] : PeerInfo struct pointer
+    // [ ID ] : PeerInfo struct pointer, changed under peerLock
     map< string, PeerInfo * > Peers;
 
+    // Peers and CollectedShares are never locked together.  Peers is
+    // only read through the peerTable snapshot, so peerLock, taken
+    // with LockPeers(), serializes the writers.  Handlers that only
+    // read CollectedShares share shareLock.
+    mutex        peerLock;
+    shared_mutex shareLock;
+
+    // Copy of Peers published by PublishPeers() on every change,
+    // and never modified.  Readers take it with PeerSnapshot() and
+    // use it without locking.
+    shared_ptr< const PeerTable > peerTable;
+
     // The Share of this Peer
     PeerShare *Share;
 
-    // Map of ShareInfo structs that this Peer has collected from others
-    map< string, ShareInfo * > CollectedShares;
+    // ShareInfo structs that this Peer has collected from others
+    // guarded by shareLock
+    ShareStore CollectedShares;
 
-    int64 recoveredSecret;
+    // Last value recovered by LagrangeInterpolate(), which may run
+    // on several handler threads at once
+    atomic< int64 > recoveredSecret;
     
     // Map of function pointers to Handler functions defined in MPC_Peer.
     // [ COMMAND ] : handler function pointer
-    // When a request is serviced by this Peer, a new thread is
-    // created to run the handler function pointed to by HandlerFunc
+    // When a request is serviced by this Peer, the handler function
+    // pointed to by HandlerFunc is run on a workerPool thread
     map< string, HandlerFunc > Handlers;
 
-    // A Router is a function that populates the PeerRoute struct
+    // Map of function pointers to handlers of binary frames other
+    // than FRAME_TEXT, which goes to Handlers.
+    // [ FrameType ] : handler function pointer
+    map< uint16, FrameHandlerFunc > FrameHandlers;
+
+    // Threads that run HandlePeer() for MainLoop(), created and
+    // deleted by MainLoop() with workerThreads threads (0 is one
+    // per core) and room for workerQueue waiting requests
+    WorkerPool *workerPool;
+    int         workerThreads;
+    int         workerQueue;
+
+    // Connections accepted by MainLoop(), guarded by clientLock
+    // [ client_sock ] : ClientInfo
+    map< int, ClientInfo > clients;
+    mutex                  clientLock;
+    int                    epollFD;
+
+    // Persistent connections to remote peers used by ConnectAndSend()
+    ConnectionPool connectionPool;
+
+    // DISTRIBUTE sends each peer only its own share value
+    bool directShares;
+
+    // PING results of CheckLivePeers(), which waits heartbeatTimeout
+    // seconds for each reply
+    Heartbeat heartbeat;
+    int       heartbeatTimeout;
+
+    // A Router is a function that returns the PeerRoute struct
+    // { ID, host, port } of a peerID
     RouterFunc routerFunc;
 
-    // PeerRoute structure that is populated by the routerFunc
-    // { ID, host, port }
-    PeerRoute peerRoute;
-
     // Poly module for polynomial operations
     MPC_PolyModule Poly;
+
+    // Cache of Lagrange basis weights, guarded by weightLock
+    // [ prime, evaluation point, sorted x values ] : weights
+    // Cleared by AddPeer() and RemovePeer() when Peers membership changes,
+    // and when it holds LAGRANGE_WEIGHTS_LIMIT sets
+    typedef tuple< int64, int64, vector<int64> > WeightKey;
+    map< WeightKey, vector<int64> > lagrangeWeights;
+    mutex weightLock;
     
 public:
     Peer( string, int, string, int, int );
@@ -72,12 +148,32 @@ public:
 
     void Shutdown();
 
+    void SetWorkerPool( int threads, int queue );
+
+    void SetDirectShares( bool direct ) { directShares = direct; }
+
+    void SetHeartbeat( int failures, int timeout );
+
     void CreatePeerShare( string, int, vector<int64>,
-                          int64, int64, int64 );
+                          int64, int64, int64,
+                          vector<int64> extraSecrets = vector<int64>(),
+                          bool packed = false );
 
     void CallHandler( const string &, PeerConnection *, string );
 
-    void HandlePeer( int, string, int );
+    bool HandlePeer( int, PeerConnection * );
+
+    void HandleFrame( PeerConnection *, const FrameHeader &, WireReader & );
+
+    void DispatchMessage( PeerConnection *, const string & );
+
+    void FinishClient( int, bool );
+
+    void BeginRequest( int );
+
+    void EndRequest( int );
+
+    void CloseIdleClients();
 
     void AddRouter( RouterFunc );
 
@@ -85,17 +181,41 @@ public:
 
     void RemovePeer( string );
 
+    unique_lock< mutex > LockPeers();
+
     bool MaxPeersReached();
 
     int MakeServerSocket( int, int );
 
     vector<string> SendToPeer( string, string, string, bool );
 
+    vector<string> SendToPeer( string, WireWriter &, bool );
+
+    size_t SendToPeers( const vector< PeerRoute > &, WireWriter &,
+                        vector< string > &failed,
+                        vector< vector< string > > *replies = NULL,
+                        int timeoutMs = -1,
+                        vector< double > *rttMs = NULL );
+
+    size_t SendToPeers( const vector< PeerRoute > &,
+                        const vector< WireWriter * > &,
+                        vector< string > &failed,
+                        vector< vector< string > > *replies = NULL,
+                        int timeoutMs = -1,
+                        vector< double > *rttMs = NULL );
+
+    WireWriter TextFrame( const string &msgType, const string &msgData );
+
     vector<string> ConnectAndSend( string host, int port,
                                    string msgType, string msgData,
                                    string peerID = "",
                                    bool waitReply = true );
 
+    vector<string> ConnectAndSend( string host, int port,
+                                   WireWriter &frame,
+                                   string peerID = "",
+                                   bool waitReply = true );
+
     void StartStabilizer( int );
 
     void RunStabilizer( int );
@@ -106,7 +226,27 @@ public:
 
     void MainLoop();
 
-    void LagrangeInterpolate( vector<int64>, vector<int64>, int64 );
+    vector<int64> LagrangeWeights( const vector<int64> &, int64,
+                                   int64 at = 0 );
+
+    void ClearLagrangeWeights();
+
+    void PublishPeers();
+
+    shared_ptr< const PeerTable > PeerSnapshot() const;
+
+    bool LagrangeInterpolate( vector<int64>, vector<int64>, int64,
+                              int64 &recovered );
+
+    vector<int64> LagrangeInterpolateBatch( const vector<int64> &,
+                                            const vector<int64> &,
+                                            size_t, int64 );
+
+    vector<int64> LagrangeInterpolatePacked( const vector<int64> &,
+                                             const vector<int64> &,
+                                             size_t, int64 );
+
+    static bool PackedSecretPoint( int64 x, size_t numPacked, int64 prime );
 };
 
 #endif
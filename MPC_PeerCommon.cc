@@ -14,25 +14,6 @@ vector<string> Tokenize( string message ) {
     return( tokens );
 }
 
-//------------------------------------------------------------
-// Prints messsage to console with id of the current thread
-//------------------------------------------------------------
-void ConsoleMsg( string msg ) {
-    cout << "[" << this_thread::get_id() << "] "
-         << msg << endl;
-}
-
-//------------------------------------------------------------
-// Prints messsage to console with id of the current thread
-// if DEBUG is #defined
-//------------------------------------------------------------
-void DebugMsg( string msg ) {
-#ifdef DEBUG
-    cout << "[" << this_thread::get_id() << "] "
-         << msg << endl;
-#endif
-}
-
 //------------------------------------------------------------
 // Attempts to open a TCP/IP socket on the specified port
 //------------------------------------------------------------
@@ -52,6 +33,16 @@ int GetSocket( int port, bool bind_socket ) {
         addr.sin_family      = AF_INET;
         addr.sin_port        = htons( port );
         addr.sin_addr.s_addr = INADDR_ANY;
+
+        // Rebind while connections of a previous server on the
+        // port are in TIME_WAIT
+        int socket_options = 1;
+        if ( setsockopt( sock, SOL_SOCKET, SO_REUSEADDR,
+                         (char *)&socket_options,
+                         sizeof(socket_options) ) < 0 ) {
+            cerr << "ERROR: GetSocket() setsockopt failed "
+                 << strerror( errno ) << endl;
+        }
         
         // bind the socket to the address
         int status = ::bind( sock, (struct sockaddr *) &addr, addr_size );
@@ -61,10 +52,11 @@ int GetSocket( int port, bool bind_socket ) {
                         " is bound on port: " + to_string( port) );
         }
         else {
-            ConsoleMsg( "ERROR: GetSocket() bind failed on socket " +
-                        to_string( sock ) + "  port " + to_string( port) +
-                        " " + strerror( errno ) );
+            ErrorMsg( "ERROR: GetSocket() bind failed on socket " +
+                      to_string( sock ) + "  port " + to_string( port) +
+                      " " + strerror( errno ) );
             close( sock ); // Failed to bind
+            sock = -1;
         }
     }
     
@@ -132,15 +124,15 @@ int GetSocketByAddrInfo( int port, bool bind_socket ) {
                 break; // Success
             }
             else {
-                ConsoleMsg( "ERROR: GetSocket() bind failed on socket " +
-                            to_string( sock ) + "  port " + to_string( port) );
+                ErrorMsg( "ERROR: GetSocket() bind failed on socket " +
+                          to_string( sock ) + "  port " + to_string( port) );
                 close( sock ); // Failed to bind
             }
         }
     }
 
     if ( rp == NULL ) { // No address succeeded
-        ConsoleMsg( "ERROR: GetSocket() failed on socket " + to_string( sock ) );
+        ErrorMsg( "ERROR: GetSocket() failed on socket " + to_string( sock ) );
         sock = 0;
     }
 
@@ -161,8 +153,8 @@ string GetServerHost( int port ) {
     int sock = GetSocket( port );
 
     if ( sock == -1 ) {
-        ConsoleMsg( "ERROR: GetServerHost() GetSocket Failed on port " +
-                    to_string(port) );
+        ErrorMsg( "ERROR: GetServerHost() GetSocket Failed on port " +
+                  to_string(port) );
         return( "None" );
     }        
 
@@ -179,8 +171,8 @@ string GetServerHost( int port ) {
     int err = connect( sock, (struct sockaddr *)&remoteaddr,
                        sizeof(remoteaddr) );
     if ( err != 0 ) {
-        ConsoleMsg( "ERROR: GetServerHost() connect failed " +
-                    string( strerror( errno ) ) );
+        ErrorMsg( "ERROR: GetServerHost() connect failed " +
+                  string( strerror( errno ) ) );
     }
     else {
         ConsoleMsg( "GetServerHost() connected to " + remoteServer );
@@ -190,8 +182,8 @@ string GetServerHost( int port ) {
     socklen_t socklen = sizeof(in_address);
     err = getsockname( sock, (struct sockaddr *) &in_address, &socklen );
     if ( err != 0 ) {
-        ConsoleMsg( "ERROR: GetServerHost() getsockname failed " +
-                    string( strerror( errno ) ) );
+        ErrorMsg( "ERROR: GetServerHost() getsockname failed " +
+                  string( strerror( errno ) ) );
     }
 
     close( sock );
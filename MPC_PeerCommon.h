@@ -10,25 +10,23 @@
 #include <string>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
 #include <algorithm>
 #include <map>
 
 #include "MPC_Common.h"
+#include "MPC_Logger.h"
 
 using namespace std;
 
-//#define DEBUG // Comment out to disable DebugMsg output
-
 // Declarations MPC_Common.cc
-void   ConsoleMsg( string msg );
-void   DebugMsg  ( string msg );
 int    GetSocket ( int port, bool bind_socket = false );
 int    GetSocketByAddrInfo( int port, bool bind_socket = false );
 string GetServerHost( int port );
 
 //------------------------------------------------------------
 // Each Peer object has a pointer to a routerFunc() that
-// populates it's PeerRoute structure telling the peer which
+// returns a PeerRoute structure telling the peer which
 // remote peer to send a message to via SendToPeer(). 
 //------------------------------------------------------------
 struct PeerRoute {
@@ -56,23 +54,9 @@ struct PeerInfo {
 };
 
 //------------------------------------------------------------
-// Container for remote Share information
-// Saved in the Peer CollectedShares map. 
+// Read only copy of the Peer Peers map, see Peer::PeerSnapshot()
+// [ ID ] : PeerInfo
 //------------------------------------------------------------
-struct ShareInfo {
-    string shareID;
-    int64  prime;
-    int64  x;      // base of polynomial exponents
-    int64  f_x;    // evaluated value of polynomial using x
-
-    // Map with keys that are the polynomial coefficient base
-    // exponent (x), and values the evaluated polynomial using
-    // the base exponent (f_x).  [ x ] : f_x
-    map< int64, int64 > evaluatedShare;
-
-    ShareInfo( string shareid = "", int64 prime = 0,
-               int64 x = 0, int64 f_x = 0 ) :
-        shareID( shareid ), prime( prime ), x( x ), f_x( f_x ) {}
-};
+typedef map< string, PeerInfo > PeerTable;
 
 #endif
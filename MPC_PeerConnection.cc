@@ -1,10 +1,22 @@
+#include <poll.h>
+#include <fcntl.h>       // O_NONBLOCK for a connect() with a timeout
+#include <netinet/tcp.h> // TCP_NODELAY
+
+#include <chrono>
+
 #include "MPC_PeerConnection.h"
+#include "MPC_Metrics.h"
 
+thread_local uint64 PeerConnection::replyID = 0;
 
 //------------------------------------------------------------
 // Set socket_status to -1 or errno on failure, 0 on success
+//
+// With timeoutMs >= 0 the connect() is non-blocking and waited for
+// with poll() for at most timeoutMs, so a peer that drops the SYN
+// fails in timeoutMs instead of the kernel's SYN retry time.
 //------------------------------------------------------------
-int PeerConnection::Connect() {
+int PeerConnection::Connect( int timeoutMs ) {
         
     if ( client_sock == 0 ) {
 
@@ -27,9 +39,43 @@ int PeerConnection::Connect() {
     remoteaddr.sin_port   = htons( port );
     inet_pton( AF_INET, host.c_str(), &(remoteaddr.sin_addr) );
         
+    int flags = fcntl( sock, F_GETFL, 0 );
+    bool nonBlocking = client_sock == 0 and timeoutMs >= 0 and
+                       fcntl( sock, F_SETFL, flags | O_NONBLOCK ) == 0;
+
     int err = connect( sock, (struct sockaddr *)&remoteaddr,
                        sizeof(remoteaddr) );
 
+    if ( err != 0 and nonBlocking and errno == EINPROGRESS ) {
+        struct pollfd pfd;
+        pfd.fd      = sock;
+        pfd.events  = POLLOUT;
+        pfd.revents = 0;
+
+        int ready;
+        do {
+            ready = poll( &pfd, 1, timeoutMs );
+        } while ( ready < 0 and errno == EINTR );
+
+        // The result of the connect() is in SO_ERROR
+        int       sockError = 0;
+        socklen_t length    = sizeof( sockError );
+        if ( ready == 0 ) {
+            sockError = ETIMEDOUT;
+        }
+        else if ( ready < 0 ) {
+            sockError = errno;
+        }
+        else {
+            getsockopt( sock, SOL_SOCKET, SO_ERROR, &sockError, &length );
+        }
+        err   = sockError ? -1 : 0;
+        errno = sockError;
+    }
+    if ( nonBlocking ) {
+        fcntl( sock, F_SETFL, flags ); // Reads and writes block
+    }
+
     if ( err != 0 ) {
         // On Ubuntu, socket error codes were in
         // /usr/include/asm-generic/errno.h
@@ -38,12 +84,12 @@ int PeerConnection::Connect() {
             err = 0;
         }
         else {
-            ConsoleMsg( "ERROR: PeerConnection::Connect() "
-                        " failed on host " + host +
-                        " port "  + to_string( port ) +
-                        " sock "  + to_string( sock ) +
-                        " errno " + to_string( errno ) + " " +
-                        strerror( errno ) );
+            ErrorMsg( "ERROR: PeerConnection::Connect() "
+                      " failed on host " + host +
+                      " port "  + to_string( port ) +
+                      " sock "  + to_string( sock ) +
+                      " errno " + to_string( errno ) + " " +
+                      strerror( errno ) );
         }
         return( err );
     }
@@ -66,9 +112,29 @@ string PeerConnection::MakeMessage( string msgType, string msgData ) {
 //------------------------------------------------------------
 // Send a message through a peer connection.
 // Returns True on success or False if there was an error.
+//
+// On a framed connection the message is a FRAME_TEXT reply to the
+// request being handled, replyID.  A request with replyID 0 wants
+// no replies, so nothing is sent.
 //------------------------------------------------------------
 bool PeerConnection::SendData( string msgType, string msgData ) {
 
+    if ( framed ) {
+        if ( replyID == 0 ) {
+            return( true );
+        }
+        string     message = MakeMessage( msgType, msgData );
+        WireWriter frame( FRAME_TEXT, message.size() );
+        frame.PutBytes( message.data(), message.size() );
+
+        if ( not SendFrame( frame, replyID ) ) {
+            return( false );
+        }
+        DebugMsg( "PeerConnection::SendData message [" + message +
+                  " ]  sent to: " + host + " port: " + to_string( port ) );
+        return( true );
+    }
+
     string message = MakeMessage( msgType, msgData );
 
     DebugMsg( "PeerConnection::SendData to " +
@@ -77,22 +143,23 @@ bool PeerConnection::SendData( string msgType, string msgData ) {
               to_string( socket_status ) );
 
     if ( socket_status != 0 ) {
-        ConsoleMsg( "ERROR: PeerConnection::SendData socket_status error " +
-                    host + " port: " + to_string( port ) );
+        ErrorMsg( "ERROR: PeerConnection::SendData socket_status error " +
+                  host + " port: " + to_string( port ) );
         return( false );
     }
 
-    int status = send( sock, message.c_str(), message.size(), 0 );
+    int status = send( sock, message.c_str(), message.size(), MSG_NOSIGNAL );
         
     if( status != message.size() ) {
-        ConsoleMsg( "ERROR: PeerConnection::SendData send error to " +
-                    host + " port: " + to_string( port ) + " " +
-                    strerror( errno ) );
+        ErrorMsg( "ERROR: PeerConnection::SendData send error to " +
+                  host + " port: " + to_string( port ) + " " +
+                  strerror( errno ) );
         return( false );
     }
+    Sent( status );
         
-    ConsoleMsg( "PeerConnection::SendData message [" + message +
-                " ]  sent to: " + host + " port: " + to_string( port ) );
+    DebugMsg( "PeerConnection::SendData message [" + message +
+              " ]  sent to: " + host + " port: " + to_string( port ) );
         
     return( true );
 }
@@ -100,30 +167,503 @@ bool PeerConnection::SendData( string msgType, string msgData ) {
 //------------------------------------------------------------
 // Receive a message from a peer connection. Returns "None"
 // if there was any error.
+//
+// A text message is every byte the client has sent, up to a NUL,
+// so a long message that arrives in several segments is read
+// whole into the received buffer.
 //------------------------------------------------------------
 string PeerConnection::ReceiveData() {
         
-    // Incoming message read buffer
-    vector<char> buffer( BUFFER_LENGTH, 0 );
-
-    // Read the incoming message
-    int valread = recv( sock, buffer.data(), BUFFER_LENGTH, 0 );
+    TakePending();
 
-    string message("None");
-    if ( valread > 0 ) {
-        message.clear();
-        vector<char>::iterator bi;
-        bi = find( buffer.begin(), buffer.end(), 0 );
-        message.append( buffer.begin(), bi );
+    // Wait for the incoming message, unless DetectFramed() has
+    // already read it
+    if ( received.Empty() and Fill() <= 0 ) {
+        return( "None" );
+    }
 
-        ConsoleMsg( "PeerConnection::ReceiveData message from: " +
-                    host + " port: " + to_string( port ) +
-                    " [" + message + "]" );
+    // Then read whatever else has arrived without waiting
+    while ( true ) {
+        if ( received.Size() == received.Capacity() ) {
+            if ( received.Capacity() >= MAX_FRAME_LENGTH ) {
+                break;
+            }
+            received.Reserve( 2 * received.Capacity() );
+        }
+        if ( Fill( MSG_DONTWAIT ) <= 0 ) {
+            break;
+        }
     }
+
+    size_t size = received.Size();
+    const char *p = received.Contiguous( size );
+
+    string message( p, find( p, p + size, 0 ) );
+    received.Consume( size );
+
+    DebugMsg( "PeerConnection::ReceiveData message from: " +
+              host + " port: " + to_string( port ) +
+              " [" + message + "]" );
         
     return( message );
 }
 
+//------------------------------------------------------------
+// Send a whole frame with requestID in its header.  Frames sent
+// by different threads are never interleaved.
+// Returns True on success or False if there was an error.
+//------------------------------------------------------------
+bool PeerConnection::SendFrame( WireWriter &frame, uint64 requestID ) {
+
+    lock_guard< mutex > lock( sendLock );
+
+    if ( socket_status != 0 ) {
+        ErrorMsg( "ERROR: PeerConnection::SendFrame socket_status error " +
+                  host + " port: " + to_string( port ) );
+        return( false );
+    }
+
+    size_t      size;
+    const char *p = frame.Finish( requestID, size );
+
+    while ( size ) {
+        ssize_t sent = send( sock, p, size, MSG_NOSIGNAL );
+        if ( sent < 0 and errno == EINTR ) {
+            continue;
+        }
+        if ( sent <= 0 ) {
+            ErrorMsg( "ERROR: PeerConnection::SendFrame send error to " +
+                      host + " port: " + to_string( port ) + " " +
+                      strerror( errno ) );
+            socket_status = -1;
+            return( false );
+        }
+        p    += sent;
+        size -= sent;
+        Sent( sent );
+    }
+    return( true );
+}
+
+//------------------------------------------------------------
+// Bytes moved by every PeerConnection, see STATS:
+//------------------------------------------------------------
+static Counter &BytesReceived() {
+    static Counter &received =
+        metrics.GetCounter( "mpc_bytes_received_total", "",
+                            "Bytes read from peer connections" );
+    return received;
+}
+
+static Counter &BytesSent() {
+    static Counter &sent =
+        metrics.GetCounter( "mpc_bytes_sent_total", "",
+                            "Bytes written to peer connections" );
+    return sent;
+}
+
+//------------------------------------------------------------
+// Read what has arrived on sock into the received buffer,
+// counting the bytes.  Returns what RingBuffer::Fill() returns.
+//------------------------------------------------------------
+ssize_t PeerConnection::Fill( int flags ) {
+
+    ssize_t bytes = received.Fill( sock, flags );
+    if ( bytes > 0 ) {
+        bytesIn.fetch_add( bytes, memory_order_relaxed );
+        BytesReceived().Add( bytes );
+    }
+    return( bytes );
+}
+
+//------------------------------------------------------------
+// Count bytes written to sock
+//------------------------------------------------------------
+void PeerConnection::Sent( size_t bytes ) {
+    bytesOut.fetch_add( bytes, memory_order_relaxed );
+    BytesSent().Add( bytes );
+}
+
+//------------------------------------------------------------
+// Read from the socket until count bytes are buffered.  Returns
+// False if the connection closed, failed or timed out first.
+//------------------------------------------------------------
+bool PeerConnection::Await( size_t count ) {
+
+    while ( received.Size() < count ) {
+        if ( Fill() <= 0 ) {
+            socket_status = -1;
+            return( false );
+        }
+    }
+    return( true );
+}
+
+//------------------------------------------------------------
+// Receive the next frame.  The header is returned and the payload
+// is left in the received buffer, read it with Payload().  A frame
+// may arrive over any number of reads, and the bytes of frames
+// behind it stay buffered for the next call.  Returns False if
+// the connection failed or the header is not a valid frame.
+//------------------------------------------------------------
+bool PeerConnection::ReceiveFrame( FrameHeader &header ) {
+
+    TakePending();
+
+    char headerBytes[ FRAME_HEADER_SIZE ];
+
+    if ( not Await( FRAME_HEADER_SIZE ) ) {
+        return( false );
+    }
+    received.Peek( headerBytes, FRAME_HEADER_SIZE );
+
+    if ( not DecodeHeader( headerBytes, header ) ) {
+        ErrorMsg( "ERROR: PeerConnection::ReceiveFrame invalid header from " +
+                  host + " port: " + to_string( port ) );
+        socket_status = -1;
+        return( false );
+    }
+
+    size_t frameSize = FRAME_HEADER_SIZE + header.length;
+
+    received.Reserve( frameSize ); // Only grows for the largest frame
+    if ( not Await( frameSize ) ) {
+        return( false );
+    }
+
+    payload     = received.Contiguous( frameSize ) + FRAME_HEADER_SIZE;
+    payloadSize = header.length;
+    pending     = frameSize;
+
+    if ( header.type == FRAME_TEXT ) {
+        DebugMsg( "PeerConnection::ReceiveData message from: " +
+                  host + " port: " + to_string( port ) + " [" +
+                  string( payload, payloadSize ) + "]" );
+    }
+    return( true );
+}
+
+//------------------------------------------------------------
+// Client side: send frame as a new request.  With waitReply the
+// text replies are returned in replies and True means they were
+// read up to the FRAME_END.  Without waitReply the requestID is 0,
+// the remote peer sends no replies, and True means it was sent.
+//------------------------------------------------------------
+bool PeerConnection::Request( WireWriter &frame, bool waitReply,
+                              vector< string > &replies ) {
+
+    uint64 requestID;
+
+    if ( not SendRequest( frame, waitReply, requestID ) ) {
+        return( false );
+    }
+    if ( not waitReply ) {
+        return( true );
+    }
+    return( AwaitReplies( requestID, replies ) );
+}
+
+//------------------------------------------------------------
+// First half of Request(): send frame and return at once.  With
+// waitReply its replies are collected for requestID, the caller
+// must then call AwaitReplies( requestID ), so that requests to
+// many peers can be in flight before waiting for any of them.
+// Returns False if the frame could not be sent.
+//------------------------------------------------------------
+bool PeerConnection::SendRequest( WireWriter &frame, bool waitReply,
+                                  uint64 &requestID ) {
+
+    requestID = 0;
+
+    if ( waitReply ) {
+        requestID = nextRequestID++;
+
+        lock_guard< mutex > lock( muxLock );
+        waiting[ requestID ].ended = false;
+    }
+
+    if ( not SendFrame( frame, requestID ) ) {
+        lock_guard< mutex > lock( muxLock );
+        waiting.erase( requestID );
+        muxReady.notify_all();
+        return( false );
+    }
+    return( true );
+}
+
+//------------------------------------------------------------
+// Wait for the replies to requestID.  One waiting caller at a
+// time reads frames and hands each to the caller it belongs to,
+// the others sleep until their replies arrive or it is their turn
+// to read.  Returns False if the connection failed first, or if
+// timeoutMs (-1 waits for the replyTimeout of the connection)
+// passed first; a late reply is then dropped and the connection
+// stays open for other requests.
+//------------------------------------------------------------
+bool PeerConnection::AwaitReplies( uint64 requestID,
+                                   vector< string > &replies,
+                                   int timeoutMs ) {
+
+    chrono::steady_clock::time_point deadline =
+        chrono::steady_clock::now() + chrono::milliseconds( timeoutMs );
+
+    unique_lock< mutex > lock( muxLock );
+
+    while ( true ) {
+        PendingReply &reply = waiting[ requestID ];
+
+        if ( reply.ended or not IsOpen() ) {
+            bool ended = reply.ended;
+            replies.swap( reply.replies );
+            waiting.erase( requestID );
+            return( ended );
+        }
+
+        int remainingMs = -1;
+        if ( timeoutMs >= 0 ) {
+            remainingMs = (int)chrono::duration_cast< chrono::milliseconds >
+                ( deadline - chrono::steady_clock::now() ).count();
+
+            if ( remainingMs <= 0 ) {
+                // Still take a reply that has already arrived
+                lock.unlock();
+                ReplyState state = PollReplies( requestID, replies );
+                if ( state == REPLY_PENDING ) {
+                    DropReplies( requestID, replies );
+                }
+                return( state == REPLY_ENDED );
+            }
+        }
+
+        if ( reading ) {
+            if ( timeoutMs >= 0 ) {
+                muxReady.wait_until( lock, deadline );
+            }
+            else {
+                muxReady.wait( lock );
+            }
+            continue;
+        }
+
+        // Read the next frame for whichever caller it belongs to
+        reading = true;
+        lock.unlock();
+
+        // With a deadline, only start reading a frame that arrives
+        // before it
+        bool ready = true;
+        if ( remainingMs >= 0 and received.Size() <= pending ) {
+            struct pollfd pfd;
+            pfd.fd     = sock;
+            pfd.events = POLLIN;
+            ready = poll( &pfd, 1, remainingMs ) > 0;
+        }
+
+        FrameHeader header;
+        bool   ok = ready and ReceiveFrame( header );
+        string text;
+        if ( ok and header.type == FRAME_TEXT ) {
+            text = Payload().Rest();
+        }
+
+        lock.lock();
+        reading = false;
+
+        if ( ok ) {
+            Deliver( header, text );
+        }
+        muxReady.notify_all();
+    }
+}
+
+//------------------------------------------------------------
+// Hand a frame read by a waiting caller to the request it
+// belongs to.  muxLock must be held.
+//------------------------------------------------------------
+void PeerConnection::Deliver( const FrameHeader &header,
+                              const string &text ) {
+
+    map< uint64, PendingReply >::iterator wi;
+    wi = waiting.find( header.requestID );
+    if ( wi != waiting.end() ) {
+        if ( header.type == FRAME_END ) {
+            wi->second.ended = true;
+        }
+        else if ( header.type == FRAME_TEXT ) {
+            wi->second.replies.push_back( text );
+        }
+    }
+}
+
+//------------------------------------------------------------
+// AwaitReplies() without waiting for the remote peer: the frames
+// already buffered or readable on the socket are read and handed
+// to their requests, unless another caller is reading them.
+// Returns REPLY_ENDED with the replies once the FRAME_END of
+// requestID is read, REPLY_FAILED if the connection failed, and
+// REPLY_PENDING otherwise.  A pending request is still waited for,
+// poll it again or give up on it with DropReplies().
+//------------------------------------------------------------
+PeerConnection::ReplyState PeerConnection::PollReplies(
+    uint64 requestID, vector< string > &replies ) {
+
+    unique_lock< mutex > lock( muxLock );
+
+    while ( true ) {
+        map< uint64, PendingReply >::iterator wi = waiting.find( requestID );
+        if ( wi == waiting.end() ) {
+            return( REPLY_FAILED );
+        }
+
+        if ( wi->second.ended or not IsOpen() ) {
+            bool ended = wi->second.ended;
+            replies.swap( wi->second.replies );
+            waiting.erase( wi );
+            return( ended ? REPLY_ENDED : REPLY_FAILED );
+        }
+
+        if ( reading or not HasData() ) {
+            return( REPLY_PENDING );
+        }
+
+        reading = true;
+        lock.unlock();
+
+        FrameHeader header;
+        bool   ok = ReceiveFrame( header );
+        string text;
+        if ( ok and header.type == FRAME_TEXT ) {
+            text = Payload().Rest();
+        }
+
+        lock.lock();
+        reading = false;
+
+        if ( ok ) {
+            Deliver( header, text );
+        }
+        muxReady.notify_all();
+    }
+}
+
+//------------------------------------------------------------
+// Stop waiting for requestID, returning the replies read so far.
+// A late reply is dropped and the connection stays open.
+//------------------------------------------------------------
+void PeerConnection::DropReplies( uint64 requestID,
+                                  vector< string > &replies ) {
+
+    lock_guard< mutex > lock( muxLock );
+
+    map< uint64, PendingReply >::iterator wi = waiting.find( requestID );
+    if ( wi != waiting.end() ) {
+        replies.swap( wi->second.replies );
+        waiting.erase( wi );
+    }
+}
+
+//------------------------------------------------------------
+// Client side: use frames on this connection, which makes it a
+// persistent connection.  Replies that take longer than
+// replyTimeout seconds fail instead of blocking forever.
+// Returns False if the connection failed.
+//------------------------------------------------------------
+bool PeerConnection::StartFramed( int replyTimeout ) {
+
+    if ( socket_status != 0 ) {
+        return( false );
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec  = replyTimeout;
+    timeout.tv_usec = 0;
+    setsockopt( sock, SOL_SOCKET, SO_RCVTIMEO,
+                (char *)&timeout, sizeof( timeout ) );
+
+    NoDelay();
+    framed = true;
+    return( true );
+}
+
+//------------------------------------------------------------
+// Server side: on the first request of an accepted connection,
+// check whether it is a frame.  A telnet message is never sent
+// with a FRAME_MAGIC first byte.  What is read stays in the
+// received buffer for ReceiveFrame() or ReceiveData().
+//------------------------------------------------------------
+bool PeerConnection::DetectFramed() {
+
+    if ( received.Empty() ) {
+        Fill();
+    }
+
+    framed = ( not received.Empty() and
+               (unsigned char)received.At( 0 ) == FRAME_MAGIC );
+    if ( framed ) {
+        NoDelay();
+    }
+    return( framed );
+}
+
+//------------------------------------------------------------
+// Send each frame at once.  A reply is a FRAME_TEXT then a small
+// FRAME_END, and with Nagle the FRAME_END waits for the ACK of the
+// first, which the other peer delays by up to 40 ms.
+//------------------------------------------------------------
+void PeerConnection::NoDelay() {
+
+    int noDelay = 1;
+    if ( setsockopt( sock, IPPROTO_TCP, TCP_NODELAY,
+                     (char *)&noDelay, sizeof( noDelay ) ) < 0 ) {
+        ErrorMsg( "ERROR: PeerConnection::NoDelay setsockopt failed " +
+                  host + " port: " + to_string( port ) + " " +
+                  strerror( errno ) );
+    }
+}
+
+//------------------------------------------------------------
+// True if an idle connection has not been closed or reset by
+// the remote peer.  Nothing is read from the socket.
+//------------------------------------------------------------
+bool PeerConnection::IsAlive() {
+
+    if ( socket_status != 0 ) {
+        return( false );
+    }
+
+    char c;
+    int  status = recv( sock, &c, 1, MSG_PEEK | MSG_DONTWAIT );
+
+    if ( status == 0 or
+         ( status < 0 and errno != EAGAIN and errno != EWOULDBLOCK ) ) {
+        socket_status = -1;
+        return( false );
+    }
+    return( true );
+}
+
+//------------------------------------------------------------
+// True if more bytes are buffered or waiting on the socket, so
+// the next ReceiveFrame() does not wait for the remote peer
+//------------------------------------------------------------
+bool PeerConnection::HasData() {
+
+    if ( received.Size() > pending ) {
+        return( true );
+    }
+    char c;
+    return( recv( sock, &c, 1, MSG_PEEK | MSG_DONTWAIT ) == 1 );
+}
+
+//------------------------------------------------------------
+// Fail the requests in flight, and any later ones, without closing
+// the socket while other threads may still be using it
+//------------------------------------------------------------
+void PeerConnection::Shutdown() {
+    socket_status = -1;
+    shutdown( sock, SHUT_RDWR );
+}
+
 //------------------------------------------------------------
 //
 //------------------------------------------------------------
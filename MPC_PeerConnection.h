@@ -5,38 +5,146 @@
 // http://cs.berry.edu/~nhamid/p2p/
 // http://cs.berry.edu/~nhamid/p2p/framework-python.html
 
+#include <atomic>
+#include <condition_variable>
+
 #include "MPC_PeerCommon.h"
+#include "MPC_WireCodec.h"
+#include "MPC_RingBuffer.h"
 
 //------------------------------------------------------------
+// A connection to a remote peer, or the server side of a
+// connection accepted from a peer (client_sock).
+//
+// A text connection, e.g. telnet, is one "msgType:msgData"
+// message and its replies.  A framed connection carries binary
+// frames (see MPC_WireCodec.h) and stays open for many requests,
+// the replies to each request end with a FRAME_END frame.
 //
+// A framed connection is multiplexed: any number of threads may
+// have requests in flight on it at once with Request().  Replies
+// are matched to their request by requestID, in whatever order
+// the remote peer sends them.
 //------------------------------------------------------------
 class PeerConnection {
 private:
-    
+
     string ID;
     string host;
     int    port;
     int    sock;
     int    client_sock;
-    int    socket_status;
+
+    // 0 while the connection is good, set by any thread that
+    // finds it failed and read without a lock by IsOpen()
+    atomic< int > socket_status;
+
+    bool         framed;      // Binary frames, persistent
+    RingBuffer   received;    // Bytes read from sock, not yet taken
+    size_t       pending;     // Bytes of the last frame still in received
+    const char  *payload;     // Payload of the last frame, in received
+    size_t       payloadSize;
+
+    // Bytes read from and written to sock, see STATS:
+    atomic< uint64 > bytesIn;
+    atomic< uint64 > bytesOut;
+
+    // Request that SendData() replies to, set by the thread
+    // handling the request
+    static thread_local uint64 replyID;
+
+    // Client side multiplexing, see Request()
+    struct PendingReply {
+        vector< string > replies;
+        bool             ended;   // FRAME_END received
+    };
+    mutex              sendLock;  // One frame written at a time
+    mutex              muxLock;   // Guards reading and waiting
+    condition_variable muxReady;  // A reply arrived or reading ended
+    bool               reading;   // A caller is in ReceiveFrame()
+    map< uint64, PendingReply > waiting; // [ requestID ] : replies
+    atomic< uint64 >   nextRequestID;
+
+    bool Await( size_t count );
+
+    void Deliver( const FrameHeader &header, const string &text );
+
+    void TakePending() { received.Consume( pending ); pending = 0; }
+
+    ssize_t Fill( int flags = 0 );
+
+    void Sent( size_t bytes );
+
+    void NoDelay();
 
 public:
     // Constructor
-    PeerConnection( string peerID, string host, int port, int client_sock ) :
-    ID( peerID ), host( host ), port( port ), client_sock( client_sock )
+    // connectTimeoutMs bounds the connect() to a remote peer, -1 waits
+    // as long as the kernel does
+    PeerConnection( string peerID, string host, int port, int client_sock,
+                    int connectTimeoutMs = -1 ) :
+    ID( peerID ), host( host ), port( port ), client_sock( client_sock ),
+    framed( false ), pending( 0 ), payload( NULL ), payloadSize( 0 ),
+    bytesIn( 0 ), bytesOut( 0 ), reading( false ), nextRequestID( 1 )
     {
-        socket_status = Connect();
+        socket_status = Connect( connectTimeoutMs );
     }
 
-    int Connect();
+    int Connect( int timeoutMs = -1 );
 
     string MakeMessage( string msgType, string msgData );
-    
+
     bool SendData( string msgType, string msgData );
 
     string ReceiveData();
 
     void Close();
 
+    bool SendFrame( WireWriter &frame, uint64 requestID );
+
+    bool ReceiveFrame( FrameHeader &header );
+
+    bool Request( WireWriter &frame, bool waitReply,
+                  vector< string > &replies );
+
+    bool SendRequest( WireWriter &frame, bool waitReply, uint64 &requestID );
+
+    bool AwaitReplies( uint64 requestID, vector< string > &replies,
+                       int timeoutMs = -1 );
+
+    // What PollReplies() found for a request
+    enum ReplyState { REPLY_PENDING, REPLY_ENDED, REPLY_FAILED };
+
+    ReplyState PollReplies( uint64 requestID, vector< string > &replies );
+
+    void DropReplies( uint64 requestID, vector< string > &replies );
+
+    // Payload of the last frame, valid until the next receive
+    WireReader Payload() const {
+        return WireReader( payload, payloadSize );
+    }
+
+    bool StartFramed( int replyTimeout );
+
+    bool DetectFramed();
+
+    bool Framed() const { return framed; }
+
+    static void SetReplyID( uint64 requestID ) { replyID = requestID; }
+
+    bool IsOpen() const { return socket_status == 0; }
+
+    bool IsAlive();
+
+    bool HasData();
+
+    void Shutdown();
+
+    string PeerID() const { return ID; }
+
+    int Socket() const { return sock; }
+
+    uint64 BytesIn()  const { return bytesIn.load( memory_order_relaxed ); }
+    uint64 BytesOut() const { return bytesOut.load( memory_order_relaxed ); }
 };
 #endif
@@ -1,6 +1,25 @@
 #include "MPC_PeerHandler.h"
 
-extern mutex peerLock; // In MPC_Peer.cc
+#include <stdlib.h>     // strtoll
+
+//------------------------------------------------------------
+// Parse all of text as a decimal int64.  Returns false, leaving
+// value unchanged, if text is empty, has other characters or is
+// out of range, so that a value sent by another peer never throws.
+//------------------------------------------------------------
+static bool ParseInt64( const string &text, int64 &value ) {
+
+    const char *begin = text.c_str();
+    char       *end   = NULL;
+
+    errno = 0;
+    long long parsed = strtoll( begin, &end, 10 );
+    if ( end == begin or *end != '\0' or errno == ERANGE ) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
 
 //------------------------------------------------------------
 // Constructor
@@ -23,37 +42,46 @@ MPC_Peer::MPC_Peer( string serverhost, int serverport,
     Handlers[ "PEERDATA"   ] = (HandlerFunc)(&MPC_Peer::PeerData);
     Handlers[ "DISTRIBUTE" ] = (HandlerFunc)(&MPC_Peer::Distribute);
     Handlers[ "SHAREVALUE" ] = (HandlerFunc)(&MPC_Peer::ReceiveShareValue);
+    Handlers[ "SHAREFETCH" ] = (HandlerFunc)(&MPC_Peer::ShareFetch);
     Handlers[ "LISTSHARES" ] = (HandlerFunc)(&MPC_Peer::ListShares);
     Handlers[ "LI"         ] = (HandlerFunc)(&MPC_Peer::LagrangeInterp);
     Handlers[ "LIADD"      ] = (HandlerFunc)(&MPC_Peer::LagrangeInterpAdd);
+    Handlers[ "LIBATCH"    ] = (HandlerFunc)(&MPC_Peer::LagrangeInterpBatch);
     Handlers[ "REMOVE"     ] = (HandlerFunc)(&MPC_Peer::Remove);
     Handlers[ "PING"       ] = (HandlerFunc)(&MPC_Peer::Ping);
+    Handlers[ "WORKERS"    ] = (HandlerFunc)(&MPC_Peer::WorkerStatus);
+    Handlers[ "HEALTH"     ] = (HandlerFunc)(&MPC_Peer::Health);
+    Handlers[ "LOGLEVEL"   ] = (HandlerFunc)(&MPC_Peer::SetLogging);
+    Handlers[ "STATS"      ] = (HandlerFunc)(&MPC_Peer::Stats);
     Handlers[ "COMMANDS"   ] = (HandlerFunc)(&MPC_Peer::Commands);
     Handlers[ "EXIT"       ] = (HandlerFunc)(&MPC_Peer::Exit);
+
+    // Handlers of binary frames from other peers
+    FrameHandlers[ FRAME_SHAREVALUE ] =
+        (FrameHandlerFunc)(&MPC_Peer::ReceiveShareFrame);
+    FrameHandlers[ FRAME_SHAREPOINT ] =
+        (FrameHandlerFunc)(&MPC_Peer::ReceiveSharePoint);
 }
 
 //------------------------------------------------------------
 // The Router is used by Peer::SendToPeer() to decide where to
-// send the message. It does this by updating the PeerRoute
-// structure in the Peer object. 
+// send the message. It returns the PeerRoute of peerID from the
+// peerTable snapshot, so it never waits on InsertPeer or Remove,
+// or an empty PeerRoute if peerID is not a known Peer.
 //------------------------------------------------------------
-void MPC_Peer::Router( string peerID ) {
+PeerRoute MPC_Peer::Router( string peerID ) {
+
+    shared_ptr< const PeerTable > peers = PeerSnapshot();
+
+    PeerTable::const_iterator pi = peers->find( peerID );
         
-    if ( Peers.count( peerID ) == 0 ) {
+    if ( pi == peers->end() ) {
         // peerID not in Peers map
-        peerRoute.peerID = "";
-        peerRoute.host   = "";
-        peerRoute.port   = 0;
-    }
-    else {
-        // Populate the PeerRoute struct for the requested peerID
-        PeerInfo *peerInfo = Peers[ peerID ];
-        peerRoute.peerID = peerID;
-        peerRoute.host   = peerInfo->host;
-        peerRoute.port   = peerInfo->port;
+        return PeerRoute();
     }
 
-    return;
+    // Populate the PeerRoute struct for the requested peerID
+    return PeerRoute( peerID, pi->second.host, pi->second.port );
 }
 
 //------------------------------------------------------------
@@ -71,8 +99,8 @@ void MPC_Peer::InsertPeer( PeerConnection *pc, string data ) {
     vector<string> tokens = Tokenize( data );
 
     if ( tokens.size() < 5 ) {
-        ConsoleMsg( "ERROR: MPC_Peer::InsertPeer " + name +
-                    " Tokenize failed on data [" + data + "]" );
+        ErrorMsg( "ERROR: MPC_Peer::InsertPeer " + name +
+                  " Tokenize failed on data [" + data + "]" );
         return;
     }
         
@@ -87,21 +115,24 @@ void MPC_Peer::InsertPeer( PeerConnection *pc, string data ) {
               "  host " + host + "  port " + to_string( port ) +
               " share " + shareID );
             
+    unique_lock< mutex > lock = LockPeers(); // Write Peers
+
     if ( MaxPeersReached() ) {
-        ConsoleMsg( "WARNING: MPC_Peer::InsertPeer " + name +
+        lock.unlock();
+
+        WarningMsg( "WARNING: MPC_Peer::InsertPeer " + name +
                     " Max Peers reached: " + to_string( maxPeers ) + 
                     " terminating connection" );
 
         pc->SendData( "ERROR", "InsertPeer max peers reached." );
         return;
     }
-            
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<
 
     if ( Peers.count( peerID ) == 0 and
          peerID.compare( ID ) != 0 ) {
         // peerID not in Peers map, and not this Peer ID
         AddPeer( peerID, host, port, shareID, base_x );
+        lock.unlock();
 
         DebugMsg( "MPC_Peer::InsertPeer " + name +
                   " Added peer with ID " + peerID );
@@ -109,11 +140,11 @@ void MPC_Peer::InsertPeer( PeerConnection *pc, string data ) {
         pc->SendData( "REPLY", "InsertPeer added peer " +  peerID );
     }
     else {
+        lock.unlock();
+
         pc->SendData( "ERROR", "InsertPeer Peer " + peerID +
                       " already inserted" );          
     }
-        
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
 }
     
 //------------------------------------------------------------
@@ -127,13 +158,13 @@ void MPC_Peer::ListPeers( PeerConnection *pc, string data ) {
 
     DebugMsg( "MPC_Peer::ListPeers " + name + " data [" + data + "]" );
         
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<
+    shared_ptr< const PeerTable > peers = PeerSnapshot();
 
     ostringstream ostrm;
-    ostrm << "NUMPEERS=" << Peers.size();
+    ostrm << "NUMPEERS=" << peers->size();
     int iPeer = 1;
-    map< string, PeerInfo * >::iterator pi;
-    for( pi = Peers.begin(); pi != Peers.end(); ++pi ) {
+    PeerTable::const_iterator pi;
+    for( pi = peers->begin(); pi != peers->end(); ++pi ) {
         string peerID = pi->first;
 
         ostrm << " PEER" << iPeer << "=" << peerID;
@@ -142,8 +173,6 @@ void MPC_Peer::ListPeers( PeerConnection *pc, string data ) {
     }
 
     pc->SendData( "REPLY", ostrm.str() );
-        
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
 }
     
 //------------------------------------------------------------
@@ -191,58 +220,69 @@ void MPC_Peer::ListShares( PeerConnection *pc, string data ) {
 
     DebugMsg( "MPC_Peer::ListShares " + name + " data [" + data + "]" );
         
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<
+    shared_lock< shared_mutex > lock( shareLock ); // Read CollectedShares
 
     ostringstream ostrm;
-    ostrm << name + " NUMSHARES=" << CollectedShares.size();
+    ostrm << name + " NUMSHARES=" << CollectedShares.Size();
     int iShare = 1;
 
-    // Iterate through the CollectedShares map of this Peer
-    map< string, ShareInfo * >::iterator si;
-    for( si = CollectedShares.begin(); si != CollectedShares.end(); ++si ) {
-        string     shareID    = si->first;
-        ShareInfo *pShareInfo = si->second;
+    // Iterate through the CollectedShares of this Peer by shareID
+    map< string, size_t >::const_iterator si;
+    for( si  = CollectedShares.Index().begin();
+         si != CollectedShares.Index().end(); ++si ) {
+        string           shareID    = si->first;
+        const ShareInfo *pShareInfo = &CollectedShares[ si->second ];
 
         ostrm << " SHARE" << iShare << "=[" << shareID
               << " x=" << pShareInfo->x << " f_x=" << pShareInfo->f_x;
 
-        // Iterate through the ShareInfo evaluatedShare map
-        map< int64, int64 >::iterator ei;
-        for ( ei =  pShareInfo->evaluatedShare.begin();
-              ei != pShareInfo->evaluatedShare.end(); ++ei ) {
-            ostrm<< " " << ei->first << " " << ei->second;
+        if ( pShareInfo->numSecrets > 1 ) {
+            ostrm << " VECTOR=" << pShareInfo->numSecrets;
+        }
+        if ( pShareInfo->numPacked > 1 ) {
+            ostrm << " PACKED=" << pShareInfo->numPacked;
+        }
+        if ( pShareInfo->direct ) {
+            ostrm << " DIRECT";
+        }
+
+        // Iterate through the ShareInfo evaluated x, f_x pairs
+        for ( size_t i = 0; i < pShareInfo->NumPoints(); i++ ) {
+            ostrm<< " " << pShareInfo->evaluatedX[ i ]
+                 << " " << pShareInfo->F_x( i );
         }
         ostrm << "]  ";
             
         ++iShare;
     }
 
+    lock.unlock();
+
     pc->SendData( "REPLY", ostrm.str() );
-        
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
 }
     
 //------------------------------------------------------------
 // LI message handler.  data is a shareID
 // 
-// CollectedShares is this Peers map of ShareInfo structs
+// CollectedShares is this Peers store of ShareInfo structs
 // Each ShareInfo struct corresponds to a remote Peer
 //
 // ShareInfo contains:
 //    int64  x;
 //    int64  f_x;
-//    map< int64, int64 > evaluatedShare;
+//    vector< int64 > evaluatedX;
+//    vector< int64 > evaluatedF_x;
 //
 // x   is the Peers own base exponent
 // f_x is the Peers polynomial evaluated at x
 //
-// evaluatedShare is a map of { x, f_x } pairs (key, value)
-// of the other Peers base exponent (x) evaluated at this Peers
-// polynomial into f_x.
+// evaluatedX and evaluatedF_x are the { x, f_x } pairs, sorted
+// by x, of the other Peers base exponent (x) evaluated at this
+// Peers polynomial into f_x.
 //
 // A complete share in terms of x, f_x pairs is then:
 // [ x, f_x, x.i, f_x.i, x.j, f_x.j, x.k, f_x.k, ... ]
-// where x.i, f_x.i... are the remote Peer values from evaluatedShare
+// where x.i, f_x.i... are the remote Peer values from evaluatedX
 //------------------------------------------------------------
 void MPC_Peer::LagrangeInterp( PeerConnection *pc, string data ) {
 
@@ -251,44 +291,84 @@ void MPC_Peer::LagrangeInterp( PeerConnection *pc, string data ) {
     vector<string> tokens = Tokenize( data );
 
     if ( tokens.size() < 1 ) {
-        ConsoleMsg( "ERROR: MPC_Peer::LagrangeInterp " + name +
-                    " Tokenize failed on data [" + data + "]" );
+        ErrorMsg( "ERROR: MPC_Peer::LagrangeInterp " + name +
+                  " Tokenize failed on data [" + data + "]" );
         return;
     }
     string shareID = tokens[0];
+
+    // Values of a direct share are held by the other Peers
+    FetchSharePoints( tokens );
+
+    shared_lock< shared_mutex > lock( shareLock ); // Read CollectedShares
         
     // Get the ShareInfo for this shareID
-    if ( CollectedShares.count( shareID ) == 0 ) {
-        ConsoleMsg( "ERROR::MPC_Peer LagrangeInterp " + name +
-                    " failed to find share " + shareID +
-                    " in CollectedShares" );
+    size_t s = CollectedShares.Find( shareID );
+    if ( s == ShareStore::npos ) {
+        ErrorMsg( "ERROR::MPC_Peer LagrangeInterp " + name +
+                  " failed to find share " + shareID +
+                  " in CollectedShares" );
         return;
     }
-        
-    // Is the mutex lock needed?  CP
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<
 
-    ShareInfo *pShareInfo = CollectedShares[ shareID ];
-        
-    // Get the x,f_x pairs into vectors for Peer::LagrangeInterpolate
-    vector< int64 > x_vec;
-    vector< int64 > f_x_vec;
+    const ShareInfo *pShareInfo = &CollectedShares[ s ];
 
-    // Insert the x, f_x pairs from the ShareInfo evaluatedShare map
-    map< int64, int64 >::iterator ei;
-    for ( ei  = pShareInfo->evaluatedShare.begin();
-          ei != pShareInfo->evaluatedShare.end(); ++ ei ) {
-            
-        x_vec.push_back  ( ei->first  );
-        f_x_vec.push_back( ei->second );
+    // With fewer points any value could be the secret
+    if ( pShareInfo->NumPoints() < pShareInfo->PointsNeeded() ) {
+        ErrorMsg( "ERROR: MPC_Peer::LagrangeInterp " + name + " " +
+                  shareID + " has " +
+                  to_string( pShareInfo->NumPoints() ) + " points, " +
+                  to_string( pShareInfo->PointsNeeded() ) +
+                  " are needed to recover it" );
+        return;
     }
         
-    Peer::LagrangeInterpolate( x_vec, f_x_vec, pShareInfo->prime );
+    // The x, f_x pairs of secret 0 for Peer::LagrangeInterpolate
+    vector< int64 > f_x_vec = pShareInfo->Column();
+        
+    int64 recovered;
+    if ( not Peer::LagrangeInterpolate( pShareInfo->evaluatedX, f_x_vec,
+                                        pShareInfo->prime, recovered ) ) {
+        ErrorMsg( "ERROR: MPC_Peer::LagrangeInterp " + name + " " +
+                  shareID + " has a repeated x, not recovered" );
+        return;
+    }
 
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
+    // A vector share recovers every secret with the same weights
+    vector< int64 > recoveredVector;
+    if ( pShareInfo->numSecrets > 1 and pShareInfo->NumPoints() ) {
+        recoveredVector =
+            Peer::LagrangeInterpolateBatch( pShareInfo->evaluatedX,
+                                            pShareInfo->evaluatedF_x,
+                                            pShareInfo->numSecrets,
+                                            pShareInfo->prime );
+    }
+    // A packed share recovers each secret at its own x = -j
+    else if ( pShareInfo->numPacked > 1 ) {
+        recoveredVector =
+            Peer::LagrangeInterpolatePacked( pShareInfo->evaluatedX,
+                                             f_x_vec,
+                                             pShareInfo->numPacked,
+                                             pShareInfo->prime );
+        if ( recoveredVector.empty() ) {
+            return; // An x is a secret point
+        }
+    }
+
+    lock.unlock();
 
     ConsoleMsg( "MPC_Peer::LagrangeInterp " + name + " Recovered value " +
-                to_string( recoveredSecret ) + " from " + shareID );
+                to_string( recovered ) + " from " + shareID );
+
+    if ( recoveredVector.size() ) {
+        ostringstream ostrm;
+        for( size_t v = 0; v < recoveredVector.size(); v++ ) {
+            ostrm << " " << recoveredVector[ v ];
+        }
+        ConsoleMsg( "MPC_Peer::LagrangeInterp " + name +
+                    " Recovered vector [" + ostrm.str() + " ] from " +
+                    shareID );
+    }
 }
 
 //------------------------------------------------------------
@@ -302,89 +382,267 @@ void MPC_Peer::LagrangeInterpAdd( PeerConnection *pc, string data ) {
     vector<string> tokens = Tokenize( data );
 
     if ( tokens.size() < 2 ) {
-        ConsoleMsg( "ERROR: MPC_Peer::LagrangeInterpAdd " + name +
-                    " Tokenize failed on data [" + data + "]" );
+        ErrorMsg( "ERROR: MPC_Peer::LagrangeInterpAdd " + name +
+                  " Tokenize failed on data [" + data + "]" );
         return;
     }
     string shareID_1 = tokens[0];
     string shareID_2 = tokens[1];
+
+    // Values of a direct share are held by the other Peers
+    FetchSharePoints( tokens );
+
+    shared_lock< shared_mutex > lock( shareLock ); // Read CollectedShares
         
-    // Check that the shareID's are in the Peers CollectedShares map
-    if ( CollectedShares.count( shareID_1 ) == 0 ) {
-        ConsoleMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
-                    " failed to find share " + shareID_1 +
-                    " in CollectedShares" );
+    // Check that the shareID's are in the Peers CollectedShares
+    size_t s1 = CollectedShares.Find( shareID_1 );
+    size_t s2 = CollectedShares.Find( shareID_2 );
+    if ( s1 == ShareStore::npos ) {
+        ErrorMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
+                  " failed to find share " + shareID_1 +
+                  " in CollectedShares" );
         return;
     }
-    if ( CollectedShares.count( shareID_2 ) == 0 ) {
-        ConsoleMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
-                    " failed to find share " + shareID_2 +
-                    " in CollectedShares" );
+    if ( s2 == ShareStore::npos ) {
+        ErrorMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
+                  " failed to find share " + shareID_2 +
+                  " in CollectedShares" );
         return;
     }
-        
-    // Is the mutex lock needed?  CP
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<
 
     // Get the ShareInfo for both shareID's
-    ShareInfo *pShareInfo_1 = CollectedShares[ shareID_1 ];
-    ShareInfo *pShareInfo_2 = CollectedShares[ shareID_2 ];
+    const ShareInfo *pShareInfo_1 = &CollectedShares[ s1 ];
+    const ShareInfo *pShareInfo_2 = &CollectedShares[ s2 ];
 
-    if ( pShareInfo_1->evaluatedShare.size() !=
-         pShareInfo_2->evaluatedShare.size() ) {
+    if ( pShareInfo_1->NumPoints() != pShareInfo_2->NumPoints() ) {
             
-        ConsoleMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
-                    " share " + shareID_1 + " and " + shareID_2 +
-                    " do not have the same length evaluatedShare maps" );
+        ErrorMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
+                  " share " + shareID_1 + " and " + shareID_2 +
+                  " do not have the same number of evaluated values" );
+        return;
+    }
+    if ( pShareInfo_1->NumPoints() < max( pShareInfo_1->PointsNeeded(),
+                                          pShareInfo_2->PointsNeeded() ) ) {
+        ErrorMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
+                  " share " + shareID_1 + " and " + shareID_2 + " have " +
+                  to_string( pShareInfo_1->NumPoints() ) +
+                  " points, too few to recover their sum" );
+        return;
+    }
+    if ( pShareInfo_1->evaluatedX != pShareInfo_2->evaluatedX ) {
+        ErrorMsg( "ERROR: MPC_Peer LagrangeInterpAdd "
+                  " evaluated values have different x keys" );
         return;
     }
         
-    // Get the x,f_x pairs into vectors for Peer::LagrangeInterpolate
-    vector< int64 > x_vec;
-    vector< int64 > f_x_vec;
+    // Sum the f_x values of both shares at each x into f_x_vec
+    vector< int64 > f_x_vec( pShareInfo_1->NumPoints() );
+    for( size_t i = 0; i < f_x_vec.size(); i++ ) {
+        f_x_vec[ i ] = pShareInfo_1->F_x( i ) + pShareInfo_2->F_x( i );
+    }
 
-    // Iterate through both ShareID ShareInfo evaluatedShare maps
-    // simultaneously and sum the f_x values into f_x_vec
-    map<int64, int64>::iterator ei1;
-    map<int64, int64>::iterator ei2;
-    for( ei1 =  pShareInfo_1->evaluatedShare.begin(),
-             ei2 =  pShareInfo_2->evaluatedShare.begin();
-         ei1 != pShareInfo_1->evaluatedShare.end() or
-             ei2 != pShareInfo_2->evaluatedShare.end();
-         ++ei1, ++ei2 ) {
+    int64 recovered;
+    if ( not Peer::LagrangeInterpolate( pShareInfo_1->evaluatedX, f_x_vec,
+                                        pShareInfo_1->prime, recovered ) ) {
+        ErrorMsg( "ERROR::MPC_Peer LagrangeInterpAdd " + name +
+                  " share " + shareID_1 + " and " + shareID_2 +
+                  " have a repeated x, not recovered" );
+        return;
+    }
 
-        if ( ei1->first != ei2->first ) {
-            ConsoleMsg( "ERROR: MPC_Peer LagrangeInterpAdd "
-                        " evaluatedShare maps have different x keys" );
-            return;
+    lock.unlock();
+
+    ConsoleMsg( "MPC_Peer::LagrangeInterpAdd " + name + " Recovered value "+
+                to_string( recovered ) + " from the sum of " +
+                shareID_1 + " and " + shareID_2 );
+}
+
+//------------------------------------------------------------
+// LIBATCH message handler.  data is a list of shareID's, or
+// empty to recover every share in CollectedShares.
+//
+// Shares are grouped by prime and by the x values of their
+// evaluated values.  Each group is recovered with one call
+// to Peer::LagrangeInterpolateBatch, sharing the basis weights.
+// A vector share adds one column per secret to its group.
+// A packed share is recovered on its own at x = 0, -1, ...
+// Replies with all recovered values in one message:
+//   REPLY:NUMSHARES=n shareID=value shareID=v0,v1,v2 ...
+// where value is NONE for a share that is not in CollectedShares
+// or has fewer evaluated values than PointsNeeded().
+//------------------------------------------------------------
+void MPC_Peer::LagrangeInterpBatch( PeerConnection *pc, string data ) {
+
+    DebugMsg( "MPC_Peer::LagrangeInterpBatch " + name +
+              " data [" + data + "]" );
+
+    vector<string> shareIDs = Tokenize( data );
+
+    // Group key [ prime, x values ] : shareID's in the group
+    typedef pair< int64, vector< int64 > > GroupKey;
+    map< GroupKey, vector< string > > groups;
+    map< GroupKey, vector< int64 > >  groupValues;  // f_x rows by x
+    map< GroupKey, size_t >           groupColumns; // values per row
+    map< string, size_t >             shareColumns; // values per share
+
+    // Packed shares are not grouped, shareID : [ prime, x values ]
+    map< string, GroupKey >         packedKeys;
+    map< string, vector< int64 > >  packedValues; // f_x by x
+    map< string, size_t >           packedCount;  // secrets per share
+
+    // Recovered value for each shareID, filled in per group
+    map< string, string > recovered;
+
+    if ( shareIDs.empty() ) {
+        shared_lock< shared_mutex > lock( shareLock ); // Read CollectedShares
+
+        map< string, size_t >::const_iterator si;
+        for( si  = CollectedShares.Index().begin();
+             si != CollectedShares.Index().end(); ++si ) {
+            shareIDs.push_back( si->first );
         }
-                            
-        x_vec.push_back( ei1->first ); // Same x for shareID_1 shareID_2
-        f_x_vec.push_back( ei1->second + ei2->second );
     }
 
-    Peer::LagrangeInterpolate( x_vec, f_x_vec, pShareInfo_1->prime );
+    // Values of direct shares are held by the other Peers
+    FetchSharePoints( shareIDs );
 
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
+    shared_lock< shared_mutex > lock( shareLock ); // Read CollectedShares
 
-    ConsoleMsg( "MPC_Peer::LagrangeInterpAdd " + name + " Recovered value "+
-                to_string( recoveredSecret ) + " from the sum of " +
-                shareID_1 + " and " + shareID_2 );
+    // [ shareID ] : index in CollectedShares of the grouped shares
+    map< string, size_t > shareIndex;
+
+    for( size_t s = 0; s < shareIDs.size(); s++ ) {
+        if ( recovered.count( shareIDs[ s ] ) ) {
+            continue; // Listed more than once
+        }
+        recovered[ shareIDs[ s ] ] = "NONE";
+
+        size_t index = CollectedShares.Find( shareIDs[ s ] );
+        if ( index == ShareStore::npos ) {
+            continue;
+        }
+        const ShareInfo *pShareInfo = &CollectedShares[ index ];
+
+        if ( pShareInfo->NumPoints() < pShareInfo->PointsNeeded() ) {
+            ErrorMsg( "ERROR: MPC_Peer::LagrangeInterpBatch " + name + " " +
+                      shareIDs[ s ] + " has " +
+                      to_string( pShareInfo->NumPoints() ) + " points, " +
+                      to_string( pShareInfo->PointsNeeded() ) +
+                      " are needed to recover it" );
+            continue;
+        }
+
+        GroupKey key( pShareInfo->prime, pShareInfo->evaluatedX );
+
+        if ( pShareInfo->numPacked > 1 ) {
+            packedKeys  [ shareIDs[ s ] ] = key;
+            packedValues[ shareIDs[ s ] ] = pShareInfo->Column();
+            packedCount [ shareIDs[ s ] ] = pShareInfo->numPacked;
+            continue;
+        }
+        shareIndex[ shareIDs[ s ] ] = index;
+
+        groups[ key ].push_back( shareIDs[ s ] );
+        groupColumns[ key ] += pShareInfo->numSecrets;
+        shareColumns[ shareIDs[ s ] ] = pShareInfo->numSecrets;
+    }
+
+    // Lay out each group as rows of x, with one column per share,
+    // or numSecrets columns for a vector share
+    map< GroupKey, vector< string > >::iterator gi;
+    for( gi = groups.begin(); gi != groups.end(); ++gi ) {
+        size_t           numColumns = groupColumns[ gi->first ];
+        vector< int64 > &f_x_mat    = groupValues[ gi->first ];
+
+        f_x_mat.resize( gi->first.second.size() * numColumns );
+
+        size_t column = 0;
+        for( size_t s = 0; s < gi->second.size(); s++ ) {
+            const ShareInfo *pShareInfo =
+                &CollectedShares[ shareIndex[ gi->second[ s ] ] ];
+            size_t n = pShareInfo->numSecrets;
+
+            for( size_t i = 0; i < pShareInfo->NumPoints(); i++ ) {
+                copy( pShareInfo->Row( i ), pShareInfo->Row( i ) + n,
+                      f_x_mat.begin() + i * numColumns + column );
+            }
+            column += n;
+        }
+    }
+
+    lock.unlock();
+
+    for( gi = groups.begin(); gi != groups.end(); ++gi ) {
+        vector< int64 > values =
+            LagrangeInterpolateBatch( gi->first.second,       // x values
+                                      groupValues[ gi->first ],
+                                      groupColumns[ gi->first ],
+                                      gi->first.first );      // prime
+        if ( values.empty() ) {
+            continue; // An x is repeated, NONE
+        }
+
+        // Each share takes its next numSecrets columns
+        size_t column = 0;
+        for( size_t s = 0; s < gi->second.size(); s++ ) {
+            size_t        n = shareColumns[ gi->second[ s ] ];
+            ostringstream value;
+
+            for( size_t v = 0; v < n; v++ ) {
+                value << ( v ? "," : "" ) << values[ column + v ];
+            }
+            recovered[ gi->second[ s ] ] = value.str();
+            column += n;
+        }
+    }
+
+    map< string, GroupKey >::iterator pki;
+    for( pki = packedKeys.begin(); pki != packedKeys.end(); ++pki ) {
+        vector< int64 > values =
+            LagrangeInterpolatePacked( pki->second.second,   // x values
+                                       packedValues[ pki->first ],
+                                       packedCount[ pki->first ],
+                                       pki->second.first );  // prime
+        if ( values.empty() ) {
+            continue; // An x is a secret point, NONE
+        }
+        ostringstream value;
+        for( size_t v = 0; v < values.size(); v++ ) {
+            value << ( v ? "," : "" ) << values[ v ];
+        }
+        recovered[ pki->first ] = value.str();
+    }
+
+    ostringstream ostrm;
+    ostrm << "NUMSHARES=" << shareIDs.size();
+    for( size_t s = 0; s < shareIDs.size(); s++ ) {
+        ostrm << " " << shareIDs[ s ] << "=" << recovered[ shareIDs[ s ] ];
+    }
+
+    ConsoleMsg( "MPC_Peer::LagrangeInterpBatch " + name +
+                " Recovered " + ostrm.str() );
+
+    pc->SendData( "REPLY", ostrm.str() );
 }
 
 //------------------------------------------------------------
 // DISTRIBUTE message handler.
 // For each Peer in the Peers map, evaluate this peers polynomial
 // at the base exponent of remote Peers and send the updated
-// values in a SHAREVALUE command to the remote Peers with SendToPeer() 
+// values in a SHAREVALUE frame to the remote Peers with
+// SendToPeers().  The Peers are taken from the peerTable and sent to
+// with it released, all at once, and the reply lists the Peers
+// that did not acknowledge the SHAREVALUE:
+//     "DISTRIBUTE ACK: name SENT=n FAILED=m peerID..."
+//
+// In direct mode (directShares, or data "DIRECT") each Peer is
+// sent only the value at its own x in a SHAREPOINT frame, and
+// recovers a share by fetching the others with SHAREFETCH.
+// data "BROADCAST" sends every value to every Peer.
 //------------------------------------------------------------
 void MPC_Peer::Distribute( PeerConnection *pc, string data ) {
 
     DebugMsg( "MPC_Peer::Distribute " + name + " data [" + data + "]" );
-        
-    // Acknowledge the DISTRIBUTE
-    string reply = "DISTRIBUTE ACK: " + name;
-    pc->SendData( "REPLY", reply );
 
     // First evaluate this Peers own share at x and update the
     // Peer Share object f_x .... This may not be needed?
@@ -396,89 +654,170 @@ void MPC_Peer::Distribute( PeerConnection *pc, string data ) {
     // current network of Peers, store in peerBaseExponents vector.
     // We will then iterate through this vector to compute f_x for
     // each base exponent x and store the pairs in evaluatedShare map
-    vector< int64 > peerBaseExponents; // List of all peer base exponents
-    vector< int64 >::iterator bi;
+    vector< int64 >     peerBaseExponents; // List of all peer base exponents
+    vector< PeerRoute > peerRoutes;        // Where to send SHAREVALUE
+    vector< int64 >     peerX;             // x of each peerRoutes Peer
+    vector< string >    failed;            // Peers not sent to or not ACK
         
-    peerLock.lock();  // Critical Section Lock <<<<<<<<<<<<<<
+    shared_ptr< const PeerTable > peers = PeerSnapshot();
+
+    PeerTable::const_iterator pi;
+    for( pi = peers->begin(); pi != peers->end(); ++pi ) {
+        string          peerID = pi->first;
+        const PeerInfo &pInfo  = pi->second;
+
+        // The value of a packed share at -j is secret j
+        if ( Share->numPacked > 1 and
+             PackedSecretPoint( pInfo.x, Share->numPacked, Share->prime ) ) {
+            ErrorMsg( "ERROR: MPC_Peer::Distribute " + name + " Peer " +
+                      peerID + " x " + to_string( pInfo.x ) +
+                      " is a packed secret point of " + Share->shareID );
+            failed.push_back( peerID );
+            continue;
+        }
 
-    map< string, PeerInfo * >::iterator pi;
-    for( pi = Peers.begin(); pi != Peers.end(); ++pi ) {
-        string    peerID = pi->first;
-        PeerInfo *pInfo  = pi->second;
+        peerRoutes.push_back( PeerRoute( peerID, pInfo.host, pInfo.port ) );
+        peerX.push_back( pInfo.x );
 
         if ( find( peerBaseExponents.begin(),
                    peerBaseExponents.end(),
-                   pInfo->x ) == peerBaseExponents.end() ) {
-            // pInfo->x is not in peerBaseExponents, insert it
-            peerBaseExponents.push_back( pInfo->x );
+                   pInfo.x ) == peerBaseExponents.end() ) {
+            // pInfo.x is not in peerBaseExponents, insert it
+            peerBaseExponents.push_back( pInfo.x );
         }
     }
         
-    // Evaluate polynomial at each base exponent of the Peers
-    // and insert in localEvaluatedShare map
-    map< int64, int64 > localEvaluatedShare;
-    map< int64, int64 >::iterator ei;
-    for ( bi  = peerBaseExponents.begin();
-          bi != peerBaseExponents.end(); ++bi ) {
-
-        localEvaluatedShare[ *bi ] =
-            Poly.Polynomial( Share->coef,   // This Peers Share coef
-                             *bi,           // Remote Peer x
-                             Share->prime );// This Peers Share prime
-    }
-    // Also insert the Peers own x, f_x, this will be redundant with the
+    // Also evaluate at the Peers own x, this will be redundant with the
     // Peers x, f_x sent as tokens 3 and 4 in SHAREVALUE, but will make
     // it easier when multiple shares are added, multiplied etc...
-    localEvaluatedShare[ Share->x ] = Share->f_x;
-
-    // Create a SHAREVALUE message to send to each Peer
-    // SHAREVALUE msgData string: "ShareID prime x f_x xi f_xi xj f_xj..."
-    ostringstream ostrm;
-    // Start the message with "ShareID prime" of this Peer
-    ostrm << Share->shareID << " " << Share->prime << " " ;
+    vector< int64 > evaluatedX = peerBaseExponents;
+    evaluatedX.push_back( Share->x );
+    sort( evaluatedX.begin(), evaluatedX.end() );
+    evaluatedX.erase( unique( evaluatedX.begin(), evaluatedX.end() ),
+                      evaluatedX.end() );
+
+    // Evaluate polynomial at all base exponents in one pass, each
+    // secret of a vector share, in rows of numSecrets values.  These
+    // are the x values of the SHAREVALUE from every other Peer, and
+    // StoreShareValue() reuses the evaluation
+    shared_ptr< const vector< int64 > > evaluated =
+        Share->Evaluate( evaluatedX );
+
+    // Create a FRAME_SHAREVALUE to send to each Peer, the binary
+    // form of the SHAREVALUE message:
+    //     shareID, prime, x, f_x, numSecrets, numPacked, numCoef, numRows
+    // then numRows rows of xi f_xi.0 .. f_xi.numSecrets-1
     // **** !!!! CP
     //     The Peers own base exponent (x) and evaluated polynomial
-    //     (f_x) are listed before the x, f_x pairs for other Peers
+    //     (f_x) are listed before the x, f_x rows for other Peers
     //     This is redundant, since they are also listed in the
     //     evaluatedShares map, but makes it easier to support
     //     multiple shares. 
     // **** !!!!
-    ostrm << Share->x << " " << Share->f_x;
-        
-    for ( ei  = localEvaluatedShare.begin();
-          ei != localEvaluatedShare.end(); ++ei ) {
-        // Add list of all x, f_x pairs
-        ostrm << " " << ei->first << " " << ei->second;
+    // A packed share of numPacked secrets in the one polynomial has
+    // the same rows as an ordinary share.  numCoef is the number of
+    // coefficients of the polynomial, the points that recover it.
+    size_t numCoef = Share->coef.size();
+    vector< int64 > rows;
+    for ( size_t i = 0; i < evaluatedX.size(); i++ ) {
+        rows.push_back( evaluatedX[ i ] );
+        rows.insert( rows.end(),
+                     evaluated->begin() + i * Share->numSecrets,
+                     evaluated->begin() + ( i + 1 ) * Share->numSecrets );
     }
 
-    DebugMsg( "MPC_Peer::Distribute " + name +
-              " SHAREVALUE: " + ostrm.str() );
-        
-    // Send the evaluated x:f_x pairs to each Peer using a SHAREVALUE msg.
-    for( pi = Peers.begin(); pi != Peers.end(); ++pi ) {
-        string    peerID = pi->first;
-        PeerInfo *pInfo  = pi->second;
+    // DISTRIBUTE:DIRECT or DISTRIBUTE:BROADCAST override the
+    // directShares mode of this Peer
+    bool direct = directShares;
+    vector< string > tokens = Tokenize( data );
+    if ( tokens.size() and tokens[0] == "DIRECT" ) {
+        direct = true;
+    }
+    else if ( tokens.size() and tokens[0] == "BROADCAST" ) {
+        direct = false;
+    }
 
-        vector<string> replies;
-        replies = SendToPeer( peerID, "SHAREVALUE", ostrm.str(), false );
+    size_t numSent;
 
-        if ( replies.size() ) {
-            if ( replies[0].find( "Send Failed" ) != string::npos ) {
-                ConsoleMsg( "ERROR: MPC_Peer::Distribute " + name +
-                            " SendToPeer() Failed to " + peerID );
-            }
+    if ( direct ) {
+        // Send each Peer a FRAME_SHAREPOINT with only the row at its
+        // own x, n bytes per Peer instead of n * n:
+        //     shareID, prime, x, numSecrets, numPacked, numCoef
+        // then one row of xi f_xi.0 .. f_xi.numSecrets-1
+        size_t rowSize = Share->numSecrets + 1;
+
+        map< int64, size_t > rowIndex; // [ x ] : row in rows
+        for ( size_t i = 0; i < rows.size(); i += rowSize ) {
+            rowIndex[ rows[ i ] ] = i;
+        }
+
+        vector< WireWriter > pointFrames;
+        pointFrames.reserve( peerRoutes.size() );
+        for ( size_t r = 0; r < peerRoutes.size(); r++ ) {
+            pointFrames.push_back(
+                WireWriter( FRAME_SHAREPOINT,
+                            4 + Share->shareID.size() +
+                            8 * ( 5 + rowSize ) ) );
+
+            WireWriter &point = pointFrames.back();
+            point.PutString( Share->shareID );
+            point.PutInt64 ( Share->prime );
+            point.PutInt64 ( Share->x );
+            point.PutInt64 ( Share->numSecrets );
+            point.PutInt64 ( Share->numPacked );
+            point.PutInt64 ( numCoef );
+            point.PutInt64s( rows.data() + rowIndex[ peerX[ r ] ], rowSize );
+        }
+
+        vector< WireWriter * > frames;
+        for ( size_t r = 0; r < pointFrames.size(); r++ ) {
+            frames.push_back( &pointFrames[ r ] );
         }
-        // ConsoleMsg success message?
+
+        DebugMsg( "MPC_Peer::Distribute " + name + " SHAREPOINT: " +
+                  Share->shareID + " " + to_string( Share->prime ) + " " +
+                  to_string( Share->x ) + " to " +
+                  to_string( peerRoutes.size() ) + " Peers" );
+
+        numSent = SendToPeers( peerRoutes, frames, failed );
     }
+    else {
+        WireWriter frame( FRAME_SHAREVALUE,
+                          4 + Share->shareID.size() + 8 * ( 7 + rows.size() ) );
+        frame.PutString( Share->shareID );
+        frame.PutInt64 ( Share->prime );
+        frame.PutInt64 ( Share->x );
+        frame.PutInt64 ( Share->f_x );
+        frame.PutInt64 ( Share->numSecrets );
+        frame.PutInt64 ( Share->numPacked );
+        frame.PutInt64 ( numCoef );
+        frame.PutInt64 ( evaluatedX.size() );
+        frame.PutInt64s( rows.data(), rows.size() );
+
+        DebugMsg( "MPC_Peer::Distribute " + name + " SHAREVALUE: " +
+                  Share->shareID + " " + to_string( Share->prime ) + " " +
+                  to_string( Share->x ) + " " + to_string( Share->f_x ) +
+                  " rows " + to_string( evaluatedX.size() ) );
         
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
-        
+        // Send the evaluated x:f_x pairs to each Peer in the
+        // SHAREVALUE frame
+        numSent = SendToPeers( peerRoutes, frame, failed );
+    }
+
+    // Acknowledge the DISTRIBUTE
+    ostringstream reply;
+    reply << "DISTRIBUTE ACK: " << name << " SENT=" << numSent
+          << " FAILED=" << failed.size();
+    for ( size_t i = 0; i < failed.size(); i++ ) {
+        reply << " " << failed[ i ];
+    }
+    pc->SendData( "REPLY", reply.str() );
 }
     
 //------------------------------------------------------------
 // SHAREVALUE message handler.
 // data from the DISTRIBUTE command.
-// This function is to populate the ShareInfo evaluatedShare map.
+// This function is to populate the ShareInfo evaluated values.
 // A remote Peer has sent this peer their share value evaluated
 // at the base exponent of this peer using the DISTRIBUTE
 // command.  Save the ShareInfo in this peers CollectedShares map. 
@@ -491,131 +830,364 @@ void MPC_Peer::ReceiveShareValue( PeerConnection *pc, string data ) {
     vector<string> tokens = Tokenize( data );
 
     if ( tokens.size() < 4 ) {
-        ConsoleMsg( "ERROR: MPC_Peer::ReceiveShareValue " + name +
-                    " Tokenize failed on data [" + data + "]" );
+        ErrorMsg( "ERROR: MPC_Peer::ReceiveShareValue " + name +
+                  " Tokenize failed on data [" + data + "]" );
         return;
     }
         
     // data is: "ShareID prime x f_x xi f_xi xj f_xj..."
     //     The Peers own base exponent (x) and evaluated polynomial
     //     (f_x) are listed before the xi, f_xi pairs for other Peers
+    // or for a vector share of n secrets, with one row per x:
+    //         "ShareID prime x f_x VECTOR=n xi f_xi.0 .. f_xi.n-1 xj ..."
+    // or for a packed share of k secrets in one polynomial:
+    //         "ShareID prime x f_x PACKED=k xi f_xi xj f_xj..."
     string shareID  = tokens[0];
-    int64  prime    = stoll( tokens[1] );
-    int64  peer_x   = stoll( tokens[2] );  // The Peers own x
-    int64  peer_f_x = stoll( tokens[3] );  // Peers own f_x
+    int64  prime;
+    int64  peer_x;    // The Peers own x
+    int64  peer_f_x;  // Peers own f_x
+
+    int64  numSecrets = 1;
+    int64  numPacked  = 1;
+    size_t firstX     = 4; // token index of the first xi
+    bool   ok         = ParseInt64( tokens[1], prime ) and
+                        ParseInt64( tokens[2], peer_x ) and
+                        ParseInt64( tokens[3], peer_f_x );
+
+    if ( tokens.size() > 4 and tokens[4].compare( 0, 7, "VECTOR=" ) == 0 ) {
+        ok     = ok and ParseInt64( tokens[4].substr( 7 ), numSecrets );
+        firstX = 5;
+    }
+    else if ( tokens.size() > 4 and
+              tokens[4].compare( 0, 7, "PACKED=" ) == 0 ) {
+        ok     = ok and ParseInt64( tokens[4].substr( 7 ), numPacked );
+        firstX = 5;
+    }
 
-    // Extract the x1 f_x1, x f_x pairs into local evaluatedShare map
-    map< int64, int64 > localEvaluatedShare;
-    map< int64, int64 >::iterator ei;
-        
-    for ( size_t i = 4; i < tokens.size(); i = i + 2 ) {
-        int64 x_in   = stoll( tokens[ i ]   );
-        int64 f_x_in = stoll( tokens[ i+1 ] );
-            
-        localEvaluatedShare[ x_in ] = f_x_in;
+    // A row takes numSecrets + 1 tokens, which also keeps
+    // numSecrets + 1 from wrapping to 0
+    if ( not ok or numSecrets < 1 or numPacked < 1 or
+         (size_t)numSecrets >= tokens.size() or
+         ( tokens.size() - firstX ) % ( numSecrets + 1 ) ) {
+        ErrorMsg( "ERROR: MPC_Peer::ReceiveShareValue " + name +
+                  " incomplete x, f_x values in [" + data + "]" );
+        return;
+    }
+
+    // Rows of xi f_xi.0 .. f_xi.numSecrets-1 as sent in the frame
+    vector< int64 > rows( tokens.size() - firstX );
+    for ( size_t i = firstX; i < tokens.size(); i++ ) {
+        if ( not ParseInt64( tokens[ i ], rows[ i - firstX ] ) ) {
+            ErrorMsg( "ERROR: MPC_Peer::ReceiveShareValue " + name +
+                      " bad value [" + tokens[ i ] + "] in [" + data + "]" );
+            return;
+        }
     }
         
     DebugMsg( "MPC_Peer::ReceiveShareValue " + name +
               " Tokenize: shareID " + shareID +
               "  prime " + to_string( prime ) );
 
-    // Create a new ShareInfo if one for shareID doesn't exist,
-    // or update the existing one with the data sent from DISTRIBUTE
-        
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<
+    // The text message does not carry numCoef
+    StoreShareValue( shareID, prime, peer_x, peer_f_x,
+                     numSecrets, numPacked, 0, rows, false );
+}
 
-    ShareInfo *pShareInfo = 0;
-        
-    if ( CollectedShares.count( shareID ) == 0 ) {
-        // This share is not in the CollectedShares map
-        // Create a new ShareInfo and insert in the map
-        pShareInfo = new ShareInfo();
-        pShareInfo->shareID = shareID;
-        pShareInfo->x       = peer_x;
-        pShareInfo->f_x     = peer_f_x;
-        pShareInfo->prime   = prime;
+//------------------------------------------------------------
+// FRAME_SHAREVALUE handler, the binary SHAREVALUE sent by
+// DISTRIBUTE between peers.  The payload is:
+//     shareID, prime, x, f_x, numSecrets, numPacked, numCoef, numRows
+// then numRows rows of xi f_xi.0 .. f_xi.numSecrets-1
+// The rows are decoded straight from the frame buffer.
+//------------------------------------------------------------
+void MPC_Peer::ReceiveShareFrame( PeerConnection *pc, WireReader &payload ) {
+
+    string shareID    = payload.GetString();
+    int64  prime      = payload.GetInt64();
+    int64  peer_x     = payload.GetInt64();  // The Peers own x
+    int64  peer_f_x   = payload.GetInt64();  // Peers own f_x
+    int64  numSecrets = payload.GetInt64();
+    int64  numPacked  = payload.GetInt64();
+    int64  numCoef    = payload.GetInt64();
+    int64  numRows    = payload.GetInt64();
+
+    // Each count is bounded by the frame length before they are
+    // multiplied, so the size check below cannot overflow
+    if ( not payload.Ok() or numSecrets < 1 or numPacked < 1 or
+         numCoef < 0 or numRows < 0 or
+         numSecrets >= MAX_FRAME_LENGTH / 8 or
+         numRows > MAX_FRAME_LENGTH / 8 or
+         payload.Remaining() != 8 * (size_t)numRows * ( numSecrets + 1 ) ) {
+        ErrorMsg( "ERROR: MPC_Peer::ReceiveShareFrame " + name +
+                  " malformed SHAREVALUE frame from " + shareID );
+        return;
+    }
 
-        // Now update the xi f_xi, xj f_xj pairs in the
-        // ShareInfo evaluatedShare map
-        for ( ei  = localEvaluatedShare.begin();
-              ei != localEvaluatedShare.end(); ++ei ) {
+    vector< int64 > rows( numRows * ( numSecrets + 1 ) );
+    payload.GetInt64s( rows.data(), rows.size() );
 
-            pShareInfo->evaluatedShare[ ei->first ] = ei->second;
-        }
+    DebugMsg( "MPC_Peer::ReceiveShareFrame " + name +
+              " shareID " + shareID + "  prime " + to_string( prime ) +
+              "  rows " + to_string( numRows ) );
+
+    StoreShareValue( shareID, prime, peer_x, peer_f_x,
+                     numSecrets, numPacked, numCoef, rows, false );
+}
 
-        // Insert the new ShareInfo struct in the CollectedShares map
-        CollectedShares[ shareID ] = pShareInfo;
+//------------------------------------------------------------
+// FRAME_SHAREPOINT handler, the value at this Peers own x sent by
+// a DISTRIBUTE in direct mode.  The payload is:
+//     shareID, prime, x, numSecrets, numPacked, numCoef
+// then one row of xi f_xi.0 .. f_xi.numSecrets-1
+//------------------------------------------------------------
+void MPC_Peer::ReceiveSharePoint( PeerConnection *pc, WireReader &payload ) {
+
+    string shareID    = payload.GetString();
+    int64  prime      = payload.GetInt64();
+    int64  peer_x     = payload.GetInt64();  // The Peers own x
+    int64  numSecrets = payload.GetInt64();
+    int64  numPacked  = payload.GetInt64();
+    int64  numCoef    = payload.GetInt64();
+
+    if ( not payload.Ok() or numSecrets < 1 or numPacked < 1 or
+         numCoef < 0 or numSecrets >= MAX_FRAME_LENGTH / 8 or
+         payload.Remaining() != 8 * (size_t)( numSecrets + 1 ) ) {
+        ErrorMsg( "ERROR: MPC_Peer::ReceiveSharePoint " + name +
+                  " malformed SHAREPOINT frame from " + shareID );
+        return;
     }
-    else {
-        // This share is already in the CollectedShares map
-        pShareInfo = CollectedShares[ shareID ];
-            
-        // Update this peer f_x in the CollectedShares ShareInfo
-        pShareInfo->x   = peer_x;
-        pShareInfo->f_x = peer_f_x;
-            
-        // Now update the x1 f_x1, x2 f_x2 pairs in the
-        // ShareInfo evaluatedShare map
-        pShareInfo->evaluatedShare.clear();
-        for ( ei  = localEvaluatedShare.begin();
-              ei != localEvaluatedShare.end(); ++ei ) {
 
-            pShareInfo->evaluatedShare[ ei->first ] = ei->second;
-        }
+    vector< int64 > row( numSecrets + 1 );
+    payload.GetInt64s( row.data(), row.size() );
+
+    DebugMsg( "MPC_Peer::ReceiveSharePoint " + name +
+              " shareID " + shareID + "  prime " + to_string( prime ) +
+              "  x " + to_string( row[0] ) );
+
+    // The Peers own f_x is not sent in direct mode
+    StoreShareValue( shareID, prime, peer_x, 0,
+                     numSecrets, numPacked, numCoef, row, true );
+}
+
+//------------------------------------------------------------
+// Store a share value received by ReceiveShareValue(),
+// ReceiveShareFrame() or ReceiveSharePoint() in CollectedShares,
+// and this Peers own share evaluated at the same x.  rows are
+// xi f_xi.0 .. f_xi.numSecrets-1 for each xi.  direct marks a
+// share with only this Peers value, see ShareInfo.
+//
+// Both ShareInfo are updated in place, reusing the storage of the
+// previous SHAREVALUE.
+//------------------------------------------------------------
+void MPC_Peer::StoreShareValue( string shareID, int64 prime,
+                                int64 peer_x, int64 peer_f_x,
+                                size_t numSecrets, size_t numPacked,
+                                size_t numCoef, const vector< int64 > &rows,
+                                bool direct ) {
+
+    size_t rowSize = numSecrets + 1;
+
+    // Evaluate this Peers own polynomial at every x of the
+    // received share, before taking shareLock.  Every Peer sends the
+    // same x values in a DISTRIBUTE round, so Share evaluates them
+    // once for the round and returns the kept values after that.
+    vector< int64 > localBaseExponents;
+    for ( size_t i = 0; i < rows.size(); i += rowSize ) {
+        localBaseExponents.push_back( rows[ i ] );
+    }
+    sort( localBaseExponents.begin(), localBaseExponents.end() );
+    localBaseExponents.erase( unique( localBaseExponents.begin(),
+                                      localBaseExponents.end() ),
+                              localBaseExponents.end() );
+
+    // Rows of Share->numSecrets values, secret 0 of a vector share
+    // is the Share coef polynomial
+    shared_ptr< const vector< int64 > > localEvaluated =
+        Share->Evaluate( localBaseExponents );
+
+    unique_lock< shared_mutex > lock( shareLock ); // Write CollectedShares
+
+    // The ShareInfo for shareID, stored the first time it is sent,
+    // then updated with the data sent from DISTRIBUTE
+    ShareInfo &shareInfo = CollectedShares[ CollectedShares.Intern( shareID ) ];
+
+    shareInfo.x          = peer_x;
+    shareInfo.f_x        = peer_f_x;
+    shareInfo.prime      = prime;
+    shareInfo.numSecrets = numSecrets;
+    shareInfo.numPacked  = numPacked;
+    shareInfo.numCoef    = numCoef;
+    shareInfo.direct     = direct;
+
+    shareInfo.ClearPoints();
+    for ( size_t i = 0; i < rows.size(); i += rowSize ) {
+        shareInfo.SetPoint( rows[ i ], &rows[ i + 1 ] );
     }
 
-    // Insert the Peers own share in evaluatedShare so that
+    // Insert the Peers own share in CollectedShares so that
     // LIADD or other multiple share MPC can operate on this
     // Peer with another Peer.
-    if ( CollectedShares.count( Share->shareID ) == 0 ) {
-        // A ShareInfo for this Peer is not in CollectedShares
-        pShareInfo = new ShareInfo();
-        pShareInfo->shareID = Share->shareID;
-        pShareInfo->x       = Share->x;
-        pShareInfo->f_x     = Share->f_x;
-        pShareInfo->prime   = Share->prime;
-
-        // Now update the xi f_xi, xj f_xj pairs in the
-        // ShareInfo evaluatedShare map from the local evaluatedShare
-        // by evaluating the Peers Polynomial at each xi
-        for ( ei =  localEvaluatedShare.begin();
-              ei != localEvaluatedShare.end(); ++ei ) {
-
-            int64 f_x = 
-                Poly.Polynomial( Share->coef,   // This Peers Share coef
-                                 ei->first,     // value of x
-                                 Share->prime );// This Peers Share prime
-                
-            pShareInfo->evaluatedShare[ ei->first ] = f_x;
+    ShareInfo &localInfo =
+        CollectedShares[ CollectedShares.Intern( Share->shareID ) ];
+
+    localInfo.x          = Share->x;
+    localInfo.f_x        = Share->f_x;
+    localInfo.prime      = Share->prime;
+    localInfo.numSecrets = Share->numSecrets;
+    localInfo.numPacked  = Share->numPacked;
+    localInfo.numCoef    = Share->coef.size();
+    localInfo.direct     = direct;
+
+    // The Peers Polynomial evaluated at each xi, sorted by xi
+    localInfo.evaluatedX   = localBaseExponents;
+    localInfo.evaluatedF_x = *localEvaluated;
+
+    lock.unlock();
+
+    ConsoleMsg( "MPC_Peer::ReceiveShareValue " + name +
+                " received from " + shareID );
+}
+
+//------------------------------------------------------------
+// SHAREFETCH message handler.  data is a list of shareID's.
+// Replies with the values this Peer holds of each share, one
+// message per share, for a Peer that recovers a share sent by
+// DISTRIBUTE in direct mode:
+//     SHAREPOINT:shareID numSecrets x f_x.0,..,f_x.n-1 x ...
+//------------------------------------------------------------
+void MPC_Peer::ShareFetch( PeerConnection *pc, string data ) {
+
+    DebugMsg( "MPC_Peer::ShareFetch " + name + " data [" + data + "]" );
+
+    vector< string > shareIDs = Tokenize( data );
+    vector< string > points;
+
+    shared_lock< shared_mutex > lock( shareLock ); // Read CollectedShares
+
+    for ( size_t s = 0; s < shareIDs.size(); s++ ) {
+        size_t index = CollectedShares.Find( shareIDs[ s ] );
+        if ( index == ShareStore::npos ) {
+            continue;
         }
+        const ShareInfo &shareInfo = CollectedShares[ index ];
+        size_t           n         = shareInfo.numSecrets;
 
-        // Insert the new ShareInfo struct in the CollectedShares map
-        CollectedShares[ Share->shareID ] = pShareInfo;
+        ostringstream ostrm;
+        ostrm << shareIDs[ s ] << " " << n;
+
+        for ( size_t i = 0; i < shareInfo.NumPoints(); i++ ) {
+            ostrm << " " << shareInfo.evaluatedX[ i ] << " ";
+            for ( size_t v = 0; v < n; v++ ) {
+                ostrm << ( v ? "," : "" ) << shareInfo.F_x( i, v );
+            }
+        }
+        points.push_back( ostrm.str() );
     }
-    else {
-        // The Peer already has it's own ShareInfo in CollectedShares
-        pShareInfo = CollectedShares[ Share->shareID ];
-            
-        // Update the x1 f_x1, x2 f_x2 pairs in the
-        // ShareInfo evaluatedShare map
-        pShareInfo->evaluatedShare.clear();
-            
-        for ( ei  = localEvaluatedShare.begin();
-              ei != localEvaluatedShare.end(); ++ei ) {
 
-            int64 f_x = 
-                Poly.Polynomial( Share->coef,   // This Peers Share coef
-                                 ei->first,     // value of x
-                                 Share->prime );// This Peers Share prime
-                
-            pShareInfo->evaluatedShare[ ei->first ] = f_x;
+    lock.unlock();
+
+    for ( size_t p = 0; p < points.size(); p++ ) {
+        pc->SendData( "SHAREPOINT", points[ p ] );
+    }
+}
+
+//------------------------------------------------------------
+// Before a share sent in direct mode is recovered, fetch the
+// values at the other Peers x with SHAREFETCH to every Peer at
+// once, and merge them into the shares in CollectedShares.
+// Shares that are not direct already have every value and are
+// not fetched.  Nothing is held locked while fetching.
+//------------------------------------------------------------
+void MPC_Peer::FetchSharePoints( vector< string > shareIDs ) {
+
+    string              fetchIDs;
+    vector< PeerRoute > peerRoutes;
+
+    {
+        shared_lock< shared_mutex > lock( shareLock ); // Read CollectedShares
+
+        for ( size_t s = 0; s < shareIDs.size(); s++ ) {
+            size_t index = CollectedShares.Find( shareIDs[ s ] );
+            if ( index != ShareStore::npos and
+                 CollectedShares[ index ].direct ) {
+                fetchIDs += ( fetchIDs.size() ? " " : "" ) + shareIDs[ s ];
+            }
         }
     }
+    if ( fetchIDs.empty() ) {
+        return;
+    }
 
-    ConsoleMsg( "MPC_Peer::ReceiveShareValue " + name +
-                " received from " + shareID );
+    shared_ptr< const PeerTable > peers = PeerSnapshot();
 
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
+    PeerTable::const_iterator pi;
+    for( pi = peers->begin(); pi != peers->end(); ++pi ) {
+        peerRoutes.push_back( PeerRoute( pi->first, pi->second.host,
+                                         pi->second.port ) );
+    }
+    if ( peerRoutes.empty() ) {
+        return;
+    }
+
+    WireWriter frame = TextFrame( "SHAREFETCH", fetchIDs );
+
+    vector< string >           failed;
+    vector< vector< string > > replies;
+    SendToPeers( peerRoutes, frame, failed, &replies );
+
+    lock_guard< shared_mutex > lock( shareLock ); // Write CollectedShares
+
+    for ( size_t r = 0; r < replies.size(); r++ ) {
+        for ( size_t m = 0; m < replies[ r ].size(); m++ ) {
+            // "SHAREPOINT:shareID numSecrets x f_x.0,..,f_x.n-1 ..."
+            size_t i = replies[ r ][ m ].find( ":" );
+            if ( replies[ r ][ m ].substr( 0, i ) != "SHAREPOINT" ) {
+                continue;
+            }
+            vector< string > tokens =
+                Tokenize( replies[ r ][ m ].substr( i + 1 ) );
+
+            size_t index = tokens.size() < 2 ? ShareStore::npos :
+                           CollectedShares.Find( tokens[0] );
+            if ( index == ShareStore::npos ) {
+                continue;
+            }
+            ShareInfo &shareInfo = CollectedShares[ index ];
+            size_t     n         = shareInfo.numSecrets;
+            int64      numSecrets;
+
+            if ( not ParseInt64( tokens[1], numSecrets ) or
+                 numSecrets != (int64)n ) {
+                ErrorMsg( "ERROR: MPC_Peer::FetchSharePoints " + name +
+                          " " + tokens[0] + " VECTOR mismatch from " +
+                          peerRoutes[ r ].peerID );
+                continue;
+            }
+
+            // Merge the rows in place by x, a row that does not parse
+            // is skipped
+            vector< int64 > values( n );
+            for ( size_t t = 2; t + 1 < tokens.size(); t += 2 ) {
+                int64        x;
+                bool         ok = ParseInt64( tokens[ t ], x );
+                stringstream strm( tokens[ t + 1 ] );
+                string       value;
+                size_t       v = 0;
+                while ( ok and getline( strm, value, ',' ) ) {
+                    ok = v < n and ParseInt64( value, values[ v++ ] );
+                }
+                if ( ok and v == n ) {
+                    shareInfo.SetPoint( x, values.data() );
+                }
+                else {
+                    ErrorMsg( "ERROR: MPC_Peer::FetchSharePoints " + name +
+                              " " + tokens[0] + " bad row [" + tokens[ t ] +
+                              " " + tokens[ t + 1 ] + "] from " +
+                              peerRoutes[ r ].peerID );
+                }
+            }
+        }
+    }
 }
 
 //------------------------------------------------------------
@@ -630,8 +1202,8 @@ void MPC_Peer::Remove( PeerConnection *pc, string data ) {
     vector<string> tokens = Tokenize( data );
 
     if ( tokens.empty() ) {
-        ConsoleMsg( "ERROR: MPC_Peer::Remove " + name +
-                    " No ID [" + data + "]" );
+        ErrorMsg( "ERROR: MPC_Peer::Remove " + name +
+                  " No ID [" + data + "]" );
         return;
     }
         
@@ -639,25 +1211,26 @@ void MPC_Peer::Remove( PeerConnection *pc, string data ) {
         
     DebugMsg( "MPC_Peer::Remove " + name + " Tokenize: peerID " + peerID );
         
-    peerLock.lock();   // Critical Section Lock <<<<<<<<<<<<<<
+    unique_lock< mutex > lock = LockPeers(); // Write Peers
 
     if ( Peers.count( peerID ) == 1 ) {
         // peerID is in Peers map
+        RemovePeer( peerID );
+        lock.unlock();
+
         string message = name + " REMOVE: Peer " + peerID + " removed.";
         ConsoleMsg( message );
 
         pc->SendData( "REPLY", message );
-
-        RemovePeer( peerID );
     }
     else {
+        lock.unlock();
+
         string message = name + " REMOVE: Peer " + peerID + " not found.";
         ConsoleMsg( message );
 
         pc->SendData( "ERROR:", message );
     }
-        
-    peerLock.unlock(); // Critical Section UnLock >>>>>>>>>>>>
 }
 
 //------------------------------------------------------------
@@ -671,6 +1244,126 @@ void MPC_Peer::Ping( PeerConnection *pc, string data ) {
     pc->SendData( "REPLY", ID );
 }
 
+//------------------------------------------------------------
+// WORKERS message handler.  Message data is not used.
+// Replies with the MainLoop worker pool queue depth and counters:
+//   REPLY:threads=n queued=n peakQueued=n maxQueued=n submitted=n
+//         completed=n stolen=n blocked=n ranInline=n
+//------------------------------------------------------------
+void MPC_Peer::WorkerStatus( PeerConnection *pc, string data ) {
+
+    DebugMsg( "MPC_Peer::WorkerStatus " + name + " data [" + data + "]" );
+
+    if ( not workerPool ) {
+        pc->SendData( "REPLY", "threads=0" );
+        return;
+    }
+
+    WorkerStats stats = workerPool->Stats();
+
+    ostringstream ostrm;
+    ostrm << "threads="     << stats.numThreads
+          << " queued="     << stats.queued
+          << " peakQueued=" << stats.peakQueued
+          << " maxQueued="  << stats.maxQueued
+          << " submitted="  << stats.submitted
+          << " completed="  << stats.completed
+          << " stolen="     << stats.stolen
+          << " blocked="    << stats.blocked
+          << " ranInline="  << stats.ranInline;
+
+    pc->SendData( "REPLY", ostrm.str() );
+}
+
+//------------------------------------------------------------
+// HEALTH message handler.
+// Reply one line per peer with the PING round trips and failures
+// recorded by CheckLivePeers()
+//------------------------------------------------------------
+void MPC_Peer::Health( PeerConnection *pc, string data ) {
+
+    DebugMsg( "MPC_Peer::Health " + name + " data [" + data + "]" );
+
+    string report = heartbeat.Report();
+
+    pc->SendData( "REPLY", report.size() ? report : "no PINGs yet" );
+}
+
+//------------------------------------------------------------
+// STATS message handler.
+// STATS: replies one line per metric: handler latencies, bytes
+// moved, CheckLivePeers() round trips and peerLock waits, with the
+// bytes of the pooled connection to each peer.  Latencies are in
+// microseconds.  STATS:PROMETHEUS replies the same in the
+// Prometheus text format, latencies in seconds.
+//------------------------------------------------------------
+void MPC_Peer::Stats( PeerConnection *pc, string data ) {
+
+    DebugMsg( "MPC_Peer::Stats " + name + " data [" + data + "]" );
+
+    vector< string > tokens = Tokenize( data );
+    bool prometheus = tokens.size() and tokens[0] == "PROMETHEUS";
+
+    vector< ConnectionTraffic > traffic = connectionPool.Traffic();
+
+    ostringstream ostrm;
+
+    if ( prometheus ) {
+        ostrm << metrics.Prometheus();
+
+        ostrm << "# HELP mpc_connection_bytes_received Bytes read from the"
+                 " pooled connection to a peer\n"
+                 "# TYPE mpc_connection_bytes_received gauge\n";
+        for ( size_t t = 0; t < traffic.size(); t++ ) {
+            ostrm << "mpc_connection_bytes_received{peer=\""
+                  << traffic[ t ].peerID << "\"} " << traffic[ t ].bytesIn
+                  << "\n";
+        }
+        ostrm << "# HELP mpc_connection_bytes_sent Bytes written to the"
+                 " pooled connection to a peer\n"
+                 "# TYPE mpc_connection_bytes_sent gauge\n";
+        for ( size_t t = 0; t < traffic.size(); t++ ) {
+            ostrm << "mpc_connection_bytes_sent{peer=\""
+                  << traffic[ t ].peerID << "\"} " << traffic[ t ].bytesOut
+                  << "\n";
+        }
+    }
+    else {
+        ostrm << metrics.Report();
+
+        for ( size_t t = 0; t < traffic.size(); t++ ) {
+            ostrm << "connection{peer=\"" << traffic[ t ].peerID << "\"}"
+                  << " in="  << traffic[ t ].bytesIn
+                  << " out=" << traffic[ t ].bytesOut << "\n";
+        }
+    }
+
+    pc->SendData( "REPLY", ostrm.str() );
+}
+
+//------------------------------------------------------------
+// LOGLEVEL message handler.
+// LOGLEVEL:<DEBUG|INFO|WARNING|ERROR|OFF> sets the level below
+// which messages are not logged, LOGLEVEL: replies the level
+//------------------------------------------------------------
+void MPC_Peer::SetLogging( PeerConnection *pc, string data ) {
+
+    DebugMsg( "MPC_Peer::SetLogging " + name + " data [" + data + "]" );
+
+    vector< string > tokens = Tokenize( data );
+
+    if ( tokens.size() ) {
+        LogLevel level;
+        if ( not ParseLogLevel( tokens[0], level ) ) {
+            pc->SendData( "ERROR", "LOGLEVEL unknown level " + tokens[0] );
+            return;
+        }
+        SetLogLevel( level );
+    }
+
+    pc->SendData( "REPLY", "logLevel=" + LogLevelName( GetLogLevel() ) );
+}
+
 //------------------------------------------------------------
 // EXIT message handler. 
 // Exit sets shutdown true to exit server main loop
@@ -701,7 +1394,7 @@ void MPC_Peer::BuildPeers( string host, int port, int hops ) {
 
     // Why does this return if MaxPeersReached?  
     if ( MaxPeersReached() or hops < 1 ) {
-        ConsoleMsg( "WARNING: MPC_Peer::BuildPeers " + name +
+        WarningMsg( "WARNING: MPC_Peer::BuildPeers " + name +
                     " max peers or zero hops " );
         return;
     }
@@ -716,8 +1409,8 @@ void MPC_Peer::BuildPeers( string host, int port, int hops ) {
     // Request PEERDATA from the remote peer 
     replies = ConnectAndSend( host, port, "PEERDATA", "" );
     if ( replies.size() == 0 ) {
-        ConsoleMsg( "ERROR: MPC_Peer::BuildPeers " + name +
-                    " PEERDATA no response" );
+        ErrorMsg( "ERROR: MPC_Peer::BuildPeers " + name +
+                  " PEERDATA no response" );
         return;
     }
     reply = replies[0];
@@ -727,8 +1420,8 @@ void MPC_Peer::BuildPeers( string host, int port, int hops ) {
     vector<string> tokens = Tokenize( reply );
         
     if ( tokens.empty() ) {
-        ConsoleMsg( "ERROR: MPC_Peer::BuildPeers" + name +
-                    " PEERDATA reply was empty" );
+        ErrorMsg( "ERROR: MPC_Peer::BuildPeers" + name +
+                  " PEERDATA reply was empty" );
         return;
     }
         
@@ -738,8 +1431,8 @@ void MPC_Peer::BuildPeers( string host, int port, int hops ) {
     remotePeerID = tokens[0].substr( i + 1, string::npos );
     if ( remotePeerID.size() < 6 ) {
         // peerID should be XXX.XXX.XXX.XXX:YYYY
-        ConsoleMsg( "ERROR: MPC_Peer::BuildPeers " + name +
-                    " Invalid PEERDATA ID " + remotePeerID );
+        ErrorMsg( "ERROR: MPC_Peer::BuildPeers " + name +
+                  " Invalid PEERDATA ID " + remotePeerID );
         return;
     }
 
@@ -772,13 +1465,16 @@ void MPC_Peer::BuildPeers( string host, int port, int hops ) {
 
     if ( msgType != "REPLY" ) {
         // INSERTPEER should reply: REPLY:InsertPeer added peer peerID
-        ConsoleMsg( "ERROR: MPC_Peer::BuildPeers " + name +
-                    " INSERTPEER response is not REPLY " + msgType );
+        ErrorMsg( "ERROR: MPC_Peer::BuildPeers " + name +
+                  " INSERTPEER response is not REPLY " + msgType );
         return;
     }
 
+    unique_lock< mutex > lock = LockPeers(); // Write Peers
+
     if ( Peers.count( remotePeerID ) == 1 ) {
-        ConsoleMsg( "WARNING: MPC_Peer::BuildPeers " + name +
+        lock.unlock();
+        WarningMsg( "WARNING: MPC_Peer::BuildPeers " + name +
                     " remotePeerID " + remotePeerID +
                     " is already in Peers" );
         return;
@@ -788,6 +1484,8 @@ void MPC_Peer::BuildPeers( string host, int port, int hops ) {
     // Add the remote peerID to this peer Peers map
     //------------------------------------------------------------
     AddPeer( remotePeerID, host, port, remoteShareID, remoteBase_x );
+
+    lock.unlock();
         
     //------------------------------------------------------------
     // Now a recursive depth-first search to add more Peers
@@ -805,16 +1503,16 @@ void MPC_Peer::BuildPeers( string host, int port, int hops ) {
         return;
     }
 
-#ifdef DEBUG
-    // Print a message to the console 
-    ostringstream ostrm;
-    ostrm << "MPC_Peer::BuildPeers Tokenize LISTPEERS response: [";
-    for ( vector<string>::iterator ri = tokens.begin();
-          ri != tokens.end(); ++ri ) {
-        ostrm << *ri << ", ";
-    } ostrm << "]";
-    DebugMsg( ostrm.str() );
-#endif
+    if ( LogEnabled( LOG_DEBUG ) ) {
+        // Print a message to the console 
+        ostringstream ostrm;
+        ostrm << "MPC_Peer::BuildPeers Tokenize LISTPEERS response: [";
+        for ( vector<string>::iterator ri = tokens.begin();
+              ri != tokens.end(); ++ri ) {
+            ostrm << *ri << ", ";
+        } ostrm << "]";
+        DebugMsg( ostrm.str() );
+    }
         
     // Get the number of peers
     string numPeersStr = tokens[0]; // REPLY:NUMPEERS=2
@@ -20,7 +20,7 @@ public:
 
     ~MPC_Peer() {}
 
-    void Router( string peerID );
+    PeerRoute Router( string peerID );
     
     void InsertPeer( PeerConnection *pc, string data );
 
@@ -36,14 +36,38 @@ public:
 
     void LagrangeInterpAdd( PeerConnection *pc, string data );
 
+    void LagrangeInterpBatch( PeerConnection *pc, string data );
+
     void Distribute( PeerConnection *pc, string data );
 
     void ReceiveShareValue( PeerConnection *pc, string data );
 
+    void ReceiveShareFrame( PeerConnection *pc, WireReader &payload );
+
+    void ReceiveSharePoint( PeerConnection *pc, WireReader &payload );
+
+    void StoreShareValue( string shareID, int64 prime,
+                          int64 peer_x, int64 peer_f_x,
+                          size_t numSecrets, size_t numPacked,
+                          size_t numCoef, const vector< int64 > &rows,
+                          bool direct );
+
+    void ShareFetch( PeerConnection *pc, string data );
+
+    void FetchSharePoints( vector< string > shareIDs );
+
     void Remove( PeerConnection *pc, string data );
 
     void Ping( PeerConnection *pc, string data );
 
+    void WorkerStatus( PeerConnection *pc, string data );
+
+    void Health( PeerConnection *pc, string data );
+
+    void SetLogging( PeerConnection *pc, string data );
+
+    void Stats( PeerConnection *pc, string data );
+
     void Exit( PeerConnection *pc, string data );
 
     void BuildPeers( string host, int port, int hops = 1 );
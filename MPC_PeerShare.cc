@@ -4,11 +4,12 @@
 PeerShare::PeerShare( string shareID, int numcoef,
                       int64 x, int64 secret, int64 prime ) :
     shareID( shareID ), numCoef( numcoef), x( x ), f_x( 0 ),
-    secret( secret ), prime( prime )
+    secret( secret ), prime( prime ), numSecrets( 1 ), numPacked( 1 )
 {
     Poly = MPC_PolyModule();  // Create local instance of PolyModule
         
     CreateSecretPolynomial();
+    coefVector = coef;
         
     // Evaluate the Share polynomial at x and store in f_x
     f_x = Poly.Polynomial( coef, x, prime );
@@ -23,7 +24,8 @@ PeerShare::PeerShare( vector<int64> _coef,
                       string shareID, int numcoef,
                       int64 x, int64 secret, int64 prime ) :
     coef( _coef ), shareID( shareID ), numCoef( numcoef), x( x ), f_x( 0 ),
-    secret( secret ), prime( prime )
+    secret( secret ), prime( prime ), numSecrets( 1 ), coefVector( _coef ),
+    numPacked( 1 )
 {
     Poly = MPC_PolyModule();  // Create local instance of PolyModule
         
@@ -45,25 +47,184 @@ int64 const PeerShare::F_x() { return f_x; }
 //------------------------------------------------------------    
 // Create list of random polynomial coefficients:
 // coef[0] = secret, coef[1]...coef[k-1] = random numbers less than Z
+//
+// For a packed share (numPacked > 1) the packedSecrets s_j are
+// embedded at x = -j instead, with the Franklin-Yung polynomial
+//   coef = L(x) + Z(x) * R(x)
+// where L is the degree numPacked-1 polynomial with L(-j) = s_j,
+// Z(x) = Π( x + j ) is zero at every -j, and R is random with
+// numCoef-1 coefficients.  That gives numCoef + numPacked - 1
+// coefficients, the number of shares needed to recover them.
 //------------------------------------------------------------
 void PeerShare::CreateSecretPolynomial() {
     if ( numCoef < 2 ) {
-        ConsoleMsg( "ERROR: PeerShare::CreateSecretPolynomial " + shareID +
-                    " number coefficients less than 2" );
+        ErrorMsg( "ERROR: PeerShare::CreateSecretPolynomial " + shareID +
+                  " number coefficients less than 2" );
         return;
     }
         
     srand( time(NULL) + rand() ); // seed random number generator
 	
+    PrimeField F( prime );
+
+    if ( numPacked > 1 ) {
+        vector<int64> L( 1, 0 ); // Interpolates the secrets
+        vector<int64> Z( 1, 1 ); // Vanishes on the secret points
+        vector<int64> R( numCoef - 1 );
+
+        for( size_t j = 0; j < numPacked; j++ ) {
+            // Lagrange basis polynomial for x = -j over the points
+            // 0, -1, ... -(numPacked-1):  Π[ ( x + m ) / ( m - j ) ]
+            vector<int64> basis( 1, 1 );
+            int64 denominator = 1;
+
+            for( size_t m = 0; m < numPacked; m++ ) {
+                if ( m == j ) {
+                    continue;
+                }
+                vector<int64> x_plus_m = { (int64)m, 1 };
+                basis       = Poly.MultPoly( basis, x_plus_m, prime );
+                denominator = F.Mul( denominator,
+                                     F.Reduce( (int64)m - (int64)j ) );
+            }
+
+            int64 scale = F.Mul( F.Reduce( packedSecrets[ j ] ),
+                                 F.Inverse( denominator ) );
+            for( size_t i = 0; i < basis.size(); i++ ) {
+                basis[ i ] = F.Mul( basis[ i ], scale );
+            }
+            L = Poly.AddPoly( L, basis, prime );
+
+            vector<int64> x_plus_j = { (int64)j, 1 };
+            Z = Poly.MultPoly( Z, x_plus_j, prime );
+        }
+
+        for( size_t i = 0; i < R.size(); i++ ) {
+            R[ i ] = F.Reduce( (int64)rand() );
+        }
+
+        coef = Poly.AddPoly( L, Poly.MultPoly( Z, R, prime ), prime );
+        return;
+    }
+
     coef.resize( numCoef ); // call resize to allocate elements
-    coef[0] = Poly.Modulus( secret, prime );// Secret value coef is modulo P
+    coef[0] = F.Reduce( secret ); // Secret value coef is modulo P
 
     for( vector<int64>::size_type i = 1; i < coef.size(); i++ ) {
         // Generate random coef, ensure they are less than prime
-        coef[i] = ( floor( Poly.Modulus( rand(), prime ) ) );
+        coef[i] = F.Reduce( (int64)rand() );
     }
 }
     
+//------------------------------------------------------------
+// Turn this share into a vector share of 1 + extraSecrets.size()
+// secrets.  Secret 0 keeps the coef polynomial, each extra secret
+// gets a polynomial of the same degree with the secret as coef[0]
+// and random coefficients less than prime.
+//------------------------------------------------------------
+void PeerShare::CreateSecretVector( const vector<int64> &extraSecrets ) {
+
+    PrimeField F( prime );
+
+    size_t numC = coef.size();
+
+    numSecrets = 1 + extraSecrets.size();
+    coefVector.assign( numC * numSecrets, 0 );
+
+    for( size_t i = 0; i < numC; i++ ) {
+        coefVector[ i * numSecrets ] = coef[ i ];
+
+        for( size_t v = 1; v < numSecrets; v++ ) {
+            coefVector[ i * numSecrets + v ] = ( i == 0 ) ?
+                F.Reduce( extraSecrets[ v - 1 ] ) : F.Reduce( (int64)rand() );
+        }
+    }
+
+    ConsoleMsg( "PeerShare::CreateSecretVector " + shareID + " " +
+                to_string( numSecrets ) + " secrets" );
+}
+
+//------------------------------------------------------------
+// Turn this share into a packed share of 1 + extraSecrets.size()
+// secrets in a single polynomial.  Secret 0 is the current secret,
+// coef[0], and the polynomial is recreated by CreateSecretPolynomial
+//------------------------------------------------------------
+void PeerShare::CreatePackedSecrets( const vector<int64> &extraSecrets ) {
+
+    packedSecrets.clear();
+    packedSecrets.push_back( coef.empty() ? secret : coef[ 0 ] );
+    packedSecrets.insert( packedSecrets.end(),
+                          extraSecrets.begin(), extraSecrets.end() );
+
+    numPacked = packedSecrets.size();
+    numCoef   = max( numCoef, (int)coef.size() );
+
+    CreateSecretPolynomial();
+
+    coefVector = coef;
+    numSecrets = 1;
+    f_x        = Poly.Polynomial( coef, x, prime );
+
+    ConsoleMsg( "PeerShare::CreatePackedSecrets " + shareID + " " +
+                to_string( numPacked ) + " secrets packed in " +
+                to_string( coef.size() ) + " coefficients" );
+
+    PrintSecretPolynomial();
+}
+
+//------------------------------------------------------------
+// Evaluate every secret polynomial at every value in x.
+// Returns one row of numSecrets values per x, so that
+//   f_x[ j * numSecrets + v ] is secret v evaluated at x[ j ]
+//------------------------------------------------------------
+vector<int64> PeerShare::EvaluateVector( const vector<int64> &x ) {
+
+    return Poly.PolynomialBatch( coefVector, numSecrets, x, prime );
+}
+
+//------------------------------------------------------------
+// Evaluate the share at every value in x, sorted, in rows of
+// numSecrets values as EvaluateVector().  The polynomials do not
+// change, so the values for each set of x are kept and returned
+// again: every SHAREVALUE of a DISTRIBUTE round carries the same
+// x values, and is evaluated once instead of once per Peer.
+// Up to SHARE_MEMO_LIMIT sets are kept, ForgetEvaluations() drops
+// them when the Peers change.
+//------------------------------------------------------------
+shared_ptr< const vector<int64> >
+PeerShare::Evaluate( const vector<int64> &x ) {
+
+    {
+        lock_guard< mutex > lock( memoLock );
+        map< vector<int64>, shared_ptr< const vector<int64> > >::iterator
+            ei = evaluations.find( x );
+        if ( ei != evaluations.end() ) {
+            return ei->second;
+        }
+    }
+
+    shared_ptr< const vector<int64> > values =
+        make_shared< const vector<int64> >(
+            numSecrets > 1 ? EvaluateVector( x )
+                           : Poly.Polynomial( coef, x, prime ) );
+
+    lock_guard< mutex > lock( memoLock );
+    if ( evaluations.size() >= SHARE_MEMO_LIMIT ) {
+        evaluations.clear();
+    }
+    evaluations[ x ] = values;
+
+    return values;
+}
+
+//------------------------------------------------------------
+// Drop the values kept by Evaluate()
+//------------------------------------------------------------
+void PeerShare::ForgetEvaluations() {
+    lock_guard< mutex > lock( memoLock );
+    evaluations.clear();
+}
+
 //------------------------------------------------------------
 //------------------------------------------------------------
 void PeerShare::PrintSecretPolynomial() {
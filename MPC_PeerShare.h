@@ -1,6 +1,8 @@
 #ifndef MPC_NETWORKSHARE_H
 #define MPC_NETWORKSHARE_H
 
+#include <memory>
+
 #include "MPC_PeerCommon.h"
 #include "MPC_PolyModule.h"
 
@@ -25,8 +27,27 @@ protected:
     int64 secret;
     int64 prime;
 
+    // Vector share: the secret above plus any extra secrets, each
+    // with its own polynomial, shared with the same DISTRIBUTE.
+    // Coefficients are stored coefficient-major, so that
+    //   coefVector[ i * numSecrets + v ] is coefficient i of secret v
+    // Secret 0 is always the coef polynomial above.
+    size_t        numSecrets;
+    vector<int64> coefVector;
+
+    // Packed share: numPacked secrets embedded in the single coef
+    // polynomial, secret j is its value at x = -j.  numPacked is 1
+    // for an ordinary share where the secret is coef[0].
+    size_t        numPacked;
+    vector<int64> packedSecrets;
+
     // Poly module for polynomial operations
     MPC_PolyModule Poly;
+
+    // Values returned by Evaluate() for each set of x, guarded by
+    // memoLock.  [ sorted x ] : rows of numSecrets values per x
+    map< vector<int64>, shared_ptr< const vector<int64> > > evaluations;
+    mutex memoLock;
     
 public:
     // Constructor #1 : No coef specified, call CreateSecretPolynomial()
@@ -44,6 +65,16 @@ public:
 
     void CreateSecretPolynomial();
 
+    void CreateSecretVector( const vector<int64> &extraSecrets );
+
+    void CreatePackedSecrets( const vector<int64> &extraSecrets );
+
+    vector<int64> EvaluateVector( const vector<int64> &x );
+
+    shared_ptr< const vector<int64> > Evaluate( const vector<int64> &x );
+
+    void ForgetEvaluations();
+
     void PrintSecretPolynomial();
     
 };
@@ -59,17 +59,39 @@ int main( int argc, char *argv[] ) {
 
     PrintConfig( &peerParams, &shareParams );
 
+    // Messages below logLevel are not logged, see LOGLEVEL:
+    if ( peerParams.logLevel.size() ) {
+        LogLevel level;
+        if ( not ParseLogLevel( peerParams.logLevel, level ) ) {
+            cerr << "ERROR: Invalid logLevel " << peerParams.logLevel << endl;
+            return 1;
+        }
+        SetLogLevel( level );
+    }
+
     // Instantiate a MPC_Peer object based on the config file parameters
-    MPC_Peer P = MPC_Peer( peerParams.serverHost, peerParams.serverPort,
-                           peerParams.name,       peerParams.maxPeers,
-                           peerParams.timeOut );
+    MPC_Peer P( peerParams.serverHost, peerParams.serverPort,
+                peerParams.name,       peerParams.maxPeers,
+                peerParams.timeOut );
 
     // Create a secret share for the Peer based on the config file
     // Do this prior to calling BuildPeers if you want share info
     P.CreatePeerShare( shareParams.name,   shareParams.numCoef,
                        shareParams.coef,   shareParams.x,
-                       shareParams.secret, shareParams.prime );
+                       shareParams.secret, shareParams.prime,
+                       shareParams.secretVector,
+                       shareParams.packed );
     
+    // Size the MainLoop handler thread pool
+    P.SetWorkerPool( peerParams.workerThreads, peerParams.workerQueue );
+
+    // DISTRIBUTE mode, see MPC_Peer::Distribute
+    P.SetDirectShares( peerParams.directShares );
+
+    // Eviction of peers that stop answering CheckLivePeers() PINGs
+    P.SetHeartbeat( peerParams.heartbeatFailures,
+                    peerParams.heartbeatTimeout );
+
     // Break the peerID host:port into separate host and port values.
     // The ID of a peer is made of a "host:port" string, where host
     // is a host name or IP address, and port the socket interface
@@ -14,25 +14,104 @@ int64 MPC_PolyModule::Modulus( int64 a, int64 b )
 // a is the polynomial coefficients
 // x is the value of the variable (exponent base)
 // P is the prime number
+//
+// Uses Horner's scheme, f_x = a[0] + x(a[1] + x(a[2] + ...)),
+// reducing mod P at every step so no intermediate overflows.
 //------------------------------------------------------------
-int64 MPC_PolyModule::Polynomial ( vector <int64> a, int64 x, int64 P )
+int64 MPC_PolyModule::Polynomial ( const vector <int64> &a, int64 x, int64 P )
 {
-    int64 f_x = 0;
+    return FieldDispatch( P, [&]( const auto &F ) {
+        int64 f_x = 0;
+        int64 x_P = F.Reduce( x );
 
-    // f_x = ( Σ a[i] * x^i ) % P;
-    for( vector<int64>::size_type i = 0; i < a.size(); i++ ) {
-        f_x = f_x + a[i] * (int64)pow(x,i);
+        for( vector<int64>::size_type i = a.size(); i-- > 0; ) {
+            f_x = F.Add( F.Mul( f_x, x_P ), F.Reduce( a[i] ) );
+        }
+        return( f_x );
+    } );
+}
+
+//------------------------------------------------------------
+// Evaluate polynomial in mod P at every value in x.
+// Returns vector f_x with f_x[j] = Polynomial( a, x[j], P )
+//
+// The coefficients are walked once, from highest degree down,
+// and each step advances the Horner sum of every x together.
+//------------------------------------------------------------
+vector <int64> MPC_PolyModule::Polynomial( const vector <int64> &a,
+                                           const vector <int64> &x, int64 P )
+{
+    return FieldDispatch( P, [&]( const auto &F ) {
+        vector <int64> x_P( x.size() );
+        vector <int64> f_x( x.size(), 0 );
+
+        for( vector<int64>::size_type j = 0; j < x.size(); j++ ) {
+            x_P[j] = F.Reduce( x[j] );
+        }
+
+        for( vector<int64>::size_type i = a.size(); i-- > 0; ) {
+            int64 c = F.Reduce( a[i] );
+
+            for( vector<int64>::size_type j = 0; j < x.size(); j++ ) {
+                f_x[j] = F.Add( F.Mul( f_x[j], x_P[j] ), c );
+            }
+        }
+        return( f_x );
+    } );
+}
+
+//------------------------------------------------------------
+// Evaluate numPoly polynomials of the same degree in mod P at
+// every value in x.
+// a holds the coefficients coefficient-major, so that
+//   a[ i * numPoly + v ] is coefficient i of polynomial v
+// Returns f_x with one row per x, so that
+//   f_x[ j * numPoly + v ] = Polynomial( polynomial v, x[j], P )
+//
+// The Horner sums of all polynomials advance together, the
+// inner loop runs over contiguous coefficients and values.
+//------------------------------------------------------------
+vector <int64> MPC_PolyModule::PolynomialBatch( const vector <int64> &a,
+                                                size_t numPoly,
+                                                const vector <int64> &x,
+                                                int64 P )
+{
+    if ( numPoly == 0 or a.size() % numPoly ) {
+        throw( runtime_error( "PolynomialBatch() "
+                              "coefficients must be a multiple of numPoly"));
     }
-    f_x = Modulus( f_x, P );
 
-    return( f_x );
+    return FieldDispatch( P, [&]( const auto &F ) {
+        size_t         numCoef = a.size() / numPoly;
+        vector <int64> a_P( a.size() );
+        vector <int64> f_x( x.size() * numPoly, 0 );
+
+        for( vector<int64>::size_type i = 0; i < a.size(); i++ ) {
+            a_P[i] = F.Reduce( a[i] );
+        }
+
+        for( vector<int64>::size_type j = 0; j < x.size(); j++ ) {
+            int64  x_P = F.Reduce( x[j] );
+            int64 *row = f_x.data() + j * numPoly;
+
+            for( size_t i = numCoef; i-- > 0; ) {
+                const int64 *c = a_P.data() + i * numPoly;
+
+                for( size_t v = 0; v < numPoly; v++ ) {
+                    row[v] = F.Add( F.Mul( row[v], x_P ), c[v] );
+                }
+            }
+        }
+        return( f_x );
+    } );
 }
 
 //------------------------------------------------------------
 // Add polynomial a and polynomial b
 // Returns vector c that is the sum polynomial of a and b
 //------------------------------------------------------------
-vector <int64> MPC_PolyModule::AddPoly( vector <int64> a, vector <int64> b )
+vector <int64> MPC_PolyModule::AddPoly( const vector <int64> &a,
+                                        const vector <int64> &b )
 {
     if ( a.size() != b.size() ) {
         throw( runtime_error( "AddPoly() "
@@ -47,12 +126,33 @@ vector <int64> MPC_PolyModule::AddPoly( vector <int64> a, vector <int64> b )
 	
     return c;
 }
+
+//------------------------------------------------------------
+// Add polynomial a and polynomial b in mod P
+// Returns vector c that is the sum polynomial of a and b, with
+// as many coefficients as the longer of a and b
+//------------------------------------------------------------
+vector <int64> MPC_PolyModule::AddPoly( const vector <int64> &a,
+                                        const vector <int64> &b, int64 P )
+{
+    return FieldDispatch( P, [&]( const auto &F ) {
+        vector <int64> c( max( a.size(), b.size() ), 0 );
+
+        for( vector<int64>::size_type i = 0; i < c.size(); i++ ) {
+            int64 a_i = i < a.size() ? F.Reduce( a[i] ) : 0;
+            int64 b_i = i < b.size() ? F.Reduce( b[i] ) : 0;
+            c[i] = F.Add( a_i, b_i );
+        }
+        return c;
+    } );
+}
     
 //------------------------------------------------------------
 // Multiply polynomial a and polynomial b
 // Returns vector c that is the product of a and b
 //------------------------------------------------------------
-vector <int64> MPC_PolyModule::MultPoly( vector <int64> a, vector <int64> b )
+vector <int64> MPC_PolyModule::MultPoly( const vector <int64> &a,
+                                         const vector <int64> &b )
 {
     if ( a.size() != b.size() ) {
         throw( runtime_error( "MultPoly() "
@@ -73,6 +173,37 @@ vector <int64> MPC_PolyModule::MultPoly( vector <int64> a, vector <int64> b )
     return c;
 }
 
+//------------------------------------------------------------
+// Multiply polynomial a and polynomial b in mod P
+// Returns vector c that is the product of a and b.  The
+// polynomials may be of different degree.
+//------------------------------------------------------------
+vector <int64> MPC_PolyModule::MultPoly( const vector <int64> &a,
+                                         const vector <int64> &b, int64 P )
+{
+    if ( a.empty() or b.empty() ) {
+        return vector <int64>();
+    }
+
+    return FieldDispatch( P, [&]( const auto &F ) {
+        vector <int64> b_P( b.size() );
+        vector <int64> c( ( a.size() + b.size() ) - 1, 0 );
+
+        for( vector<int64>::size_type j = 0; j < b.size(); j++ ) {
+            b_P[j] = F.Reduce( b[j] );
+        }
+
+        for( vector<int64>::size_type i = 0; i < a.size(); i++ ) {
+            int64 a_i = F.Reduce( a[i] );
+
+            for (vector<int64>::size_type j = 0; j < b.size(); j++ ){
+                c[i+j] = F.Add( c[i+j], F.Mul( a_i, b_P[j] ) );
+            }
+        }
+        return c;
+    } );
+}
+
 //------------------------------------------------------------
 // Takes a vector and prints to the standard output the
 // polynomial representation
@@ -91,27 +222,31 @@ void MPC_PolyModule::PrintPoly(vector <int64> a)
 }
 
 //------------------------------------------------------------
-// Decomposition of the GCD of a and b.
+// Decomposition of the GCD of a and b, for a, b >= 0.
 // Returns [x,y,z] such that x = GCD(a,b) and y*a + z*b = x
+//
+// Iterative extended Euclidean algorithm, the remainders and
+// both Bezout coefficients are carried forward together.
 //------------------------------------------------------------
 vector<int64> MPC_PolyModule::GCD( int64 a, int64 b )
 {
-    int64 G_[] = { 0, 0, 0 }; // local array for [x,y,z]
-	
-    if ( b == 0 ) {
-        G_[0] = a;
-        G_[1] = 1;
-    }
-    else {
-        int64 n = floor( a / b );
-        int64 c = Modulus( a, b );
-        vector<int64> r = GCD( b, c );
-	    
-        G_[0] = r[0];
-        G_[1] = r[2];
-        G_[2] = r[1] - r[2] * n;
+    int64 y = 1, y_next = 0; // Coefficient of a
+    int64 z = 0, z_next = 1; // Coefficient of b
+
+    while ( b != 0 ) {
+        int64 n   = a / b;
+        int64 tmp = a - n * b;
+        a      = b;
+        b      = tmp;
+        tmp    = y - n * y_next;
+        y      = y_next;
+        y_next = tmp;
+        tmp    = z - n * z_next;
+        z      = z_next;
+        z_next = tmp;
     }
-    // Copy int[] array G_ into vector<int> G
+
+    int64 G_[] = { a, y, z }; // local array for [x,y,z]
     vector<int64> G( G_, G_ + sizeof(G_) / sizeof(int64) );
     return G;
 }
@@ -122,16 +257,80 @@ vector<int64> MPC_PolyModule::GCD( int64 a, int64 b )
 //------------------------------------------------------------
 int64 MPC_PolyModule::ModInverse( int64 k, int64 prime )
 {
-    int64 r = 0;
+    return FieldDispatch( prime, [&]( const auto &F ) {
+        return( F.Inverse( F.Reduce( k ) ) );
+    } );
+}
 
-    k = Modulus( k, prime );
+//------------------------------------------------------------
+// Returns the multiplicative inverses of all of k mod prime,
+// using a single inversion (see BatchInverse).  Elements that
+// are 0 mod prime have no inverse and are returned as 0.
+//------------------------------------------------------------
+vector<int64> MPC_PolyModule::BatchModInverse( const vector<int64> &k,
+                                               int64 prime )
+{
+    return FieldDispatch( prime, [&]( const auto &F ) {
+        vector<int64> k_inv( k.size() );
+        vector<int64> prefix;
 
-    if ( k < 0 ) {
-        r = -1 * GCD( prime, -k )[2];
-    }
-    else {
-        r = GCD( prime, k )[2];
-    }
+        for( vector<int64>::size_type i = 0; i < k.size(); i++ ) {
+            k_inv[i] = F.Reduce( k[i] );
+        }
+        BatchInverse( F, k_inv, prefix );
 
-    return( Modulus( ( prime + r ), prime ) );
+        return k_inv;
+    } );
+}
+
+//------------------------------------------------------------
+// Returns the Lagrange basis weights at x = at for the points x
+// in mod prime, w[i] = Π[ ( at - x_j ) / ( x_i - x_j ) ] for j != i,
+// so that f(at) = Σ w[i] * f(x_i) for any polynomial f of degree
+// less than the number of points.  at is 0 to recover a secret.
+// Returns no weights if two x are the same mod prime, where a
+// denominator is 0 and has no inverse.
+//------------------------------------------------------------
+vector<int64> MPC_PolyModule::LagrangeWeights( const vector<int64> &x,
+                                               int64 prime, int64 at )
+{
+    return FieldDispatch( prime, [&]( const auto &F ) {
+        int64         at_P = F.Reduce( at );
+        vector<int64> x_P( x.size() );
+        vector<int64> w  ( x.size() );
+        vector<int64> denominator( x.size() );
+        vector<int64> prefix;
+
+        for( vector<int64>::size_type i = 0; i < x.size(); i++ ) {
+            x_P[i] = F.Reduce( x[i] );
+        }
+
+        for( vector<int64>::size_type i = 0; i < x.size(); i++ ) {
+            w[i]           = 1; // numerator
+            denominator[i] = 1;
+
+            for( vector<int64>::size_type j = 0; j < x.size(); j++ ) {
+                if ( i == j ) {
+                    continue;
+                }
+                w[i]           = F.Mul( w[i], F.Sub( at_P, x_P[j] ) );
+                denominator[i] = F.Mul( denominator[i],
+                                        F.Sub( x_P[i], x_P[j] ) );
+            }
+        }
+
+        for( vector<int64>::size_type i = 0; i < x.size(); i++ ) {
+            if ( denominator[i] == 0 ) {
+                return vector<int64>(); // x[i] is repeated
+            }
+        }
+
+        // Invert all denominators together, then w = num / den
+        BatchInverse( F, denominator, prefix );
+
+        for( vector<int64>::size_type i = 0; i < x.size(); i++ ) {
+            w[i] = F.Mul( w[i], denominator[i] );
+        }
+        return w;
+    } );
 }
@@ -4,8 +4,10 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include "MPC_Common.h"
+#include "MPC_PrimeField.h"
 
 using namespace std;
 
@@ -23,17 +25,34 @@ public:
 
     int64 Modulus( int64 a, int64 b );
 
-    int64 Polynomial( vector <int64> a, int64 x, int64 P );
+    int64 Polynomial( const vector <int64> &a, int64 x, int64 P );
 
-    vector <int64> AddPoly( vector <int64> a, vector <int64> b );
+    vector <int64> Polynomial( const vector <int64> &a,
+                               const vector <int64> &x, int64 P );
 
-    vector <int64> MultPoly( vector <int64> a, vector <int64> b );
+    vector <int64> PolynomialBatch( const vector <int64> &a, size_t numPoly,
+                                    const vector <int64> &x, int64 P );
+
+    vector <int64> AddPoly( const vector <int64> &a, const vector <int64> &b );
+
+    vector <int64> AddPoly( const vector <int64> &a, const vector <int64> &b,
+                            int64 P );
+
+    vector <int64> MultPoly( const vector <int64> &a, const vector <int64> &b );
+
+    vector <int64> MultPoly( const vector <int64> &a, const vector <int64> &b,
+                             int64 P );
     
     void PrintPoly( vector <int64> a );
     
     vector<int64> GCD( int64 a, int64 b );
 
     int64 ModInverse( int64 k, int64 prime );
+
+    vector<int64> BatchModInverse( const vector<int64> &k, int64 prime );
+
+    vector<int64> LagrangeWeights( const vector<int64> &x, int64 prime,
+                                   int64 at = 0 );
     
 };
 #endif
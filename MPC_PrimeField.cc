@@ -0,0 +1,42 @@
+#include "MPC_PrimeField.h"
+
+//------------------------------------------------------------
+// Constructor
+// Computes the bit length of prime and the Barrett constant mu.
+// This is the only division done by the field.
+//------------------------------------------------------------
+PrimeField::PrimeField( int64 _prime ) : prime( _prime ), k( 0 ), mu( 0 )
+{
+    if ( _prime < 2 ) {
+        throw( runtime_error( "PrimeField() "
+                              "prime must be 2 or greater" ));
+    }
+
+    while ( k < 64 and ( prime >> k ) ) { k++; }
+
+    mu = (uint64)( ( (uint128)1 << ( 2 * k ) ) / prime );
+}
+
+//------------------------------------------------------------
+// Returns a^e mod prime by square and multiply
+//------------------------------------------------------------
+int64 PrimeField::Pow( int64 a, uint64 e ) const
+{
+    int64 r = 1 % (int64)prime;
+
+    while ( e ) {
+        if ( e & 1 ) { r = Mul( r, a ); }
+        a = Mul( a, a );
+        e >>= 1;
+    }
+    return r;
+}
+
+//------------------------------------------------------------
+// Returns the multiplicative inverse of a mod prime.
+// Returns 0 for a = 0, which has no inverse.
+//------------------------------------------------------------
+int64 PrimeField::Inverse( int64 a ) const
+{
+    return InverseMod( a, (int64)prime );
+}
@@ -0,0 +1,250 @@
+#ifndef MPC_PRIMEFIELD_H
+#define MPC_PRIMEFIELD_H
+
+#include <stdexcept>
+#include <vector>
+
+#include "MPC_Common.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Returns the multiplicative inverse of a in [0,prime) mod prime
+// with the iterative extended Euclidean algorithm.  No memory is
+// allocated.  Returns 0 for a = 0, which has no inverse.
+//------------------------------------------------------------
+inline int64 InverseMod( int64 a, int64 prime )
+{
+    int64 t = 0, t_next = 1;       // Bezout coefficient of a
+    int64 r = prime, r_next = a;   // Remainders
+
+    while ( r_next ) {
+        int64 q   = r / r_next;
+        int64 tmp = t - q * t_next;
+        t      = t_next;
+        t_next = tmp;
+        tmp    = r - q * r_next;
+        r      = r_next;
+        r_next = tmp;
+    }
+    return t < 0 ? t + prime : t;
+}
+
+//------------------------------------------------------------
+// Class PrimeField
+// Arithmetic in the integers mod prime for any prime below 2^63.
+//
+// Field elements are plain int64 values in [0,prime).  Products
+// are formed in 128 bits and reduced with Barrett's method, so
+// no hardware division is done per multiply:
+//   k  = number of bits in prime
+//   mu = floor( 2^(2k) / prime )   computed once in the constructor
+//   q  = ( ( a >> (k-1) ) * mu ) >> (k+1)
+//   r  = a - q * prime             r < 3 * prime, fixed by subtraction
+// This holds for any a < 2^(2k), which covers every product of two
+// reduced elements.
+//------------------------------------------------------------
+class PrimeField {
+
+private:
+    uint64 prime;
+    int    k;       // Number of bits in prime
+    uint64 mu;      // Barrett constant floor( 2^(2k) / prime )
+
+public:
+    // Constructor
+    PrimeField( int64 prime );
+
+    int64 Prime() const { return (int64)prime; }
+
+    // Barrett reduction of a < 2^(2k), e.g. a product of two elements
+    int64 Reduce( uint128 a ) const {
+        uint128 q = ( ( a >> ( k - 1 ) ) * mu ) >> ( k + 1 );
+        uint64  r = (uint64)( a - q * prime );
+        while ( r >= prime ) { r -= prime; }
+        return (int64)r;
+    }
+
+    // Reduce any int64, including negative values, into [0,prime)
+    int64 Reduce( int64 a ) const {
+        uint64 m = a < 0 ? -(uint64)a : (uint64)a;
+        int64  r = ( 2 * k < 64 and ( m >> ( 2 * k ) ) ) ?
+                   (int64)( m % prime ) : Reduce( (uint128)m );
+        return ( a < 0 and r ) ? (int64)prime - r : r;
+    }
+
+    int64 Add( int64 a, int64 b ) const {
+        uint64 s = (uint64)a + (uint64)b;
+        return (int64)( s >= prime ? s - prime : s );
+    }
+
+    int64 Sub( int64 a, int64 b ) const {
+        return a >= b ? a - b : a - b + (int64)prime;
+    }
+
+    int64 Neg( int64 a ) const {
+        return a ? (int64)prime - a : 0;
+    }
+
+    int64 Mul( int64 a, int64 b ) const {
+        return Reduce( (uint128)a * (uint128)b );
+    }
+
+    int64 Pow( int64 a, uint64 e ) const;
+
+    int64 Inverse( int64 a ) const;
+};
+
+//------------------------------------------------------------
+// Class MersenneField
+// Arithmetic mod the Mersenne prime 2^E - 1, with the same
+// interface as PrimeField.  Since 2^E = 1 mod prime, a value
+// a = hi * 2^E + lo reduces to hi + lo, so reduction is a shift,
+// a mask and an add.  The prime is a compile-time constant.
+//------------------------------------------------------------
+template< int E >
+class MersenneField {
+
+public:
+    static const int64 prime = ( (int64)1 << E ) - 1;
+
+    MersenneField() {}
+
+    int64 Prime() const { return prime; }
+
+    // Reduction of a < 2^(2E), e.g. a product of two elements
+    int64 Reduce( uint128 a ) const {
+        uint64 r = (uint64)( ( a & prime ) + ( a >> E ) ); // r < 2^(E+1)
+        r = ( r & prime ) + ( r >> E );                    // r <= prime+1
+        return (int64)( r >= (uint64)prime ? r - prime : r );
+    }
+
+    // Reduce any int64, including negative values, into [0,prime)
+    int64 Reduce( int64 a ) const {
+        uint64 m = a < 0 ? -(uint64)a : (uint64)a;
+        int64  r = Reduce( (uint128)m );
+        return ( a < 0 and r ) ? prime - r : r;
+    }
+
+    int64 Add( int64 a, int64 b ) const {
+        int64 s = a + b;
+        return s >= prime ? s - prime : s;
+    }
+
+    int64 Sub( int64 a, int64 b ) const {
+        return a >= b ? a - b : a - b + prime;
+    }
+
+    int64 Neg( int64 a ) const {
+        return a ? prime - a : 0;
+    }
+
+    int64 Mul( int64 a, int64 b ) const {
+        return Reduce( (uint128)a * (uint128)b );
+    }
+
+    int64 Pow( int64 a, uint64 e ) const {
+        int64 r = 1;
+        while ( e ) {
+            if ( e & 1 ) { r = Mul( r, a ); }
+            a = Mul( a, a );
+            e >>= 1;
+        }
+        return r;
+    }
+
+    int64 Inverse( int64 a ) const {
+        return InverseMod( a, prime );
+    }
+};
+
+template< int E >
+const int64 MersenneField< E >::prime;
+
+//------------------------------------------------------------
+// 2^31 - 1 specialization: products fit in 64 bits, so the
+// reduction is done without any 128 bit arithmetic.
+//------------------------------------------------------------
+template<>
+inline int64 MersenneField< 31 >::Reduce( uint128 a ) const {
+    uint64 r = (uint64)a;
+    r = ( r & prime ) + ( r >> 31 );  // r < 2^34
+    r = ( r & prime ) + ( r >> 31 );  // r < prime + 8
+    return (int64)( r >= (uint64)prime ? r - prime : r );
+}
+
+template<>
+inline int64 MersenneField< 31 >::Mul( int64 a, int64 b ) const {
+    return Reduce( (uint128)( (uint64)a * (uint64)b ) );
+}
+
+//------------------------------------------------------------
+// Replaces every element of k with its inverse using Montgomery's
+// trick: one field inversion plus 3(n-1) multiplications for n
+// elements.  Elements equal to 0 have no inverse and are left 0.
+// The prefix vector is scratch space, passed in so callers can
+// reuse it.
+//------------------------------------------------------------
+template< class Field >
+void BatchInverse( const Field &F, vector<int64> &k, vector<int64> &prefix )
+{
+    prefix.resize( k.size() );
+
+    // prefix[i] = k[0] * k[1] * ... * k[i], skipping zeros
+    int64 product = 1;
+    for ( size_t i = 0; i < k.size(); i++ ) {
+        if ( k[i] ) { product = F.Mul( product, k[i] ); }
+        prefix[i] = product;
+    }
+
+    // Invert the full product once, then peel one element off
+    // at a time from the back:  1/k[i] = 1/prefix[i] * prefix[i-1]
+    int64 inverse = F.Inverse( product );
+    for ( size_t i = k.size(); i-- > 0; ) {
+        if ( k[i] == 0 ) {
+            continue;
+        }
+        int64 before = i ? prefix[i-1] : 1;
+        int64 k_inv  = F.Mul( inverse, before );
+        inverse      = F.Mul( inverse, k[i] );
+        k[i]         = k_inv;
+    }
+}
+
+typedef MersenneField< 31 > Mersenne31Field;
+typedef MersenneField< 61 > Mersenne61Field;
+
+//------------------------------------------------------------
+// Returns the PrimeField for prime, keeping the last one built
+// on this thread so the Barrett constant (a 128-bit division)
+// is only computed when the prime changes.  A peer works in a
+// single prime, so in practice each thread builds it once.
+//------------------------------------------------------------
+inline const PrimeField &CachedPrimeField( int64 prime )
+{
+    static thread_local PrimeField field( 2 );
+    if ( field.Prime() != prime ) {
+        field = PrimeField( prime );
+    }
+    return field;
+}
+
+//------------------------------------------------------------
+// Calls op( F ) with the field kernel for prime, where op is
+// usually a generic lambda.  The Mersenne kernels are used when
+// prime is 2^61-1 or 2^31-1, and the cached PrimeField for any
+// other prime.
+//------------------------------------------------------------
+template< class Op >
+auto FieldDispatch( int64 prime, Op op ) -> decltype( op( PrimeField( prime ) ) )
+{
+    if ( prime == Mersenne61Field::prime ) {
+        return op( Mersenne61Field() );
+    }
+    if ( prime == Mersenne31Field::prime ) {
+        return op( Mersenne31Field() );
+    }
+    return op( CachedPrimeField( prime ) );
+}
+
+#endif
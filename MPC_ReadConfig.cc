@@ -76,6 +76,24 @@ int ReadConfig( PeerParams *peerParams, ShareParams *shareParams,
             else if( words[0] == "hops" ) {
                 peerParams->hops = stoi( words[1] );
             }
+            else if( words[0] == "workerThreads" ) {
+                peerParams->workerThreads = stoi( words[1] );
+            }
+            else if( words[0] == "workerQueue" ) {
+                peerParams->workerQueue = stoi( words[1] );
+            }
+            else if( words[0] == "directShares" ) {
+                peerParams->directShares = stoi( words[1] );
+            }
+            else if( words[0] == "heartbeatFailures" ) {
+                peerParams->heartbeatFailures = stoi( words[1] );
+            }
+            else if( words[0] == "heartbeatTimeout" ) {
+                peerParams->heartbeatTimeout = stoi( words[1] );
+            }
+            else if( words[0] == "logLevel" ) {
+                peerParams->logLevel = words[1];
+            }
             else if( words[0] == "shareName" ) {
                 shareParams->name = words[1];
             }
@@ -106,6 +124,17 @@ int ReadConfig( PeerParams *peerParams, ShareParams *shareParams,
             else if( words[0] == "prime" ) {
                 shareParams->prime = stoll( words[1] );
             }
+            else if( words[0] == "secretVector" ) {
+                // words[1] ... are extra secrets shared with secret
+                vector<int64> _secrets;
+                for ( size_t i = 1; i < words.size(); i++ ) {
+                    _secrets.push_back( stoll( words[ i ] ) );
+                }
+                shareParams->secretVector = _secrets;
+            }
+            else if( words[0] == "packed" ) {
+                shareParams->packed = stoi( words[1] );
+            }
             else {
                 cerr << "ERROR: ReadConfig() Invalid token "
                      << words[0] << endl;
@@ -130,6 +159,12 @@ void PrintConfig( PeerParams *peerParams, ShareParams *shareParams ) {
     cout << "Peer: timeOut   : " << peerParams->timeOut    << endl;
     cout << "Peer: stabilize : " << peerParams->stabilize  << endl;
     cout << "Peer: hops      : " << peerParams->hops       << endl;
+    cout << "Peer: workerThreads: " << peerParams->workerThreads << endl;
+    cout << "Peer: workerQueue  : " << peerParams->workerQueue   << endl;
+    cout << "Peer: directShares : " << peerParams->directShares  << endl;
+    cout << "Peer: heartbeatFailures: " << peerParams->heartbeatFailures << endl;
+    cout << "Peer: heartbeatTimeout : " << peerParams->heartbeatTimeout  << endl;
+    cout << "Peer: logLevel         : " << peerParams->logLevel          << endl;
     
     cout << "Share: shareName: " << shareParams->name    << endl;
     cout << "Share: numCoef  : " << shareParams->numCoef << endl;
@@ -142,6 +177,13 @@ void PrintConfig( PeerParams *peerParams, ShareParams *shareParams ) {
     cout << "Share: x        : " << shareParams->x       << endl;
     cout << "Share: secret   : " << shareParams->secret  << endl;
     cout << "Share: prime    : " << shareParams->prime   << endl;
+    if ( shareParams->secretVector.size() ) {
+        cout << "Share: secretVector: ";
+        for ( size_t i = 0; i < shareParams->secretVector.size(); i++ ) {
+            cout << shareParams->secretVector[i] << " ";
+        } cout << endl;
+        cout << "Share: packed   : " << shareParams->packed  << endl;
+    }
     
     return;
 }
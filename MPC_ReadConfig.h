@@ -24,6 +24,12 @@ struct PeerParams {
     int    timeOut;      // timeout for MainLoop listening socket
     int    stabilize;    // timeout for CheckLivePeers()
     int    hops;
+    int    workerThreads = 0;   // MainLoop handler threads, 0: one per core
+    int    workerQueue   = DEFAULT_WORKER_QUEUE; // Requests waiting for a worker thread
+    int    directShares  = 0;   // 1: DISTRIBUTE sends each peer only its own value
+    int    heartbeatFailures = HEARTBEAT_FAILURES; // PINGs failed in a row to evict
+    int    heartbeatTimeout  = HEARTBEAT_TIMEOUT;  // Seconds to wait for a PING
+    string logLevel;     // DEBUG INFO WARNING ERROR or OFF, "": default
 };
 
 //--------------------------------------------------------------
@@ -34,6 +40,8 @@ struct ShareParams {
     int64  x;           // base of polynomial exponents
     int64  secret;
     int64  prime;
+    vector<int64> secretVector; // Extra secrets shared with secret
+    int    packed = 0;  // 1: pack secretVector in the secret polynomial
 };    
 
 #endif
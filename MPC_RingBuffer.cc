@@ -0,0 +1,110 @@
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+#include <algorithm>
+
+#include "MPC_RingBuffer.h"
+
+//------------------------------------------------------------
+// Constructor
+// capacity is rounded up to a power of two
+//------------------------------------------------------------
+RingBuffer::RingBuffer( size_t capacity ) : head( 0 ), tail( 0 ) {
+    size_t size = 1;
+    while ( size < capacity ) {
+        size <<= 1;
+    }
+    storage.resize( size );
+    mask = size - 1;
+}
+
+//------------------------------------------------------------
+// Copy the first count buffered bytes, in at most two pieces
+//------------------------------------------------------------
+void RingBuffer::Peek( char *p, size_t count ) const {
+    size_t start = head & mask;
+    size_t first = min( count, storage.size() - start );
+
+    memcpy( p, storage.data() + start, first );
+    memcpy( p + first, storage.data(), count - first );
+}
+
+//------------------------------------------------------------
+// Return the first count buffered bytes as one piece.  Only a
+// message that wraps past the end of storage is moved, the bytes
+// buffered behind it are moved with it.
+//------------------------------------------------------------
+const char *RingBuffer::Contiguous( size_t count ) {
+    size_t start = head & mask;
+
+    if ( start + count <= storage.size() ) {
+        return storage.data() + start;
+    }
+
+    // Rotate the buffered bytes to the start of storage
+    size_t size = Size();
+    rotate( storage.begin(), storage.begin() + start, storage.end() );
+
+    head = 0;
+    tail = size;
+    return storage.data();
+}
+
+//------------------------------------------------------------
+// Grow to the next power of two that holds count bytes
+//------------------------------------------------------------
+void RingBuffer::Reserve( size_t count ) {
+    if ( count <= storage.size() ) {
+        return;
+    }
+    size_t newSize = storage.size();
+    while ( newSize < count ) {
+        newSize <<= 1;
+    }
+
+    size_t size = Size();
+    vector< char > grown( newSize );
+    Peek( grown.data(), size );
+
+    storage.swap( grown );
+    mask = newSize - 1;
+    head = 0;
+    tail = size;
+}
+
+//------------------------------------------------------------
+// Read into the free space, which may wrap, with one readv()
+// style recvmsg() call
+//------------------------------------------------------------
+ssize_t RingBuffer::Fill( int sock, int flags ) {
+    size_t space = storage.size() - Size();
+    if ( space == 0 ) {
+        errno = ENOBUFS;
+        return( -1 );
+    }
+
+    size_t start = tail & mask;
+    size_t first = min( space, storage.size() - start );
+
+    struct iovec iov[2];
+    iov[0].iov_base = storage.data() + start;
+    iov[0].iov_len  = first;
+    iov[1].iov_base = storage.data();
+    iov[1].iov_len  = space - first;
+
+    struct msghdr msg;
+    memset( &msg, 0, sizeof( msg ) );
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = iov[1].iov_len ? 2 : 1;
+
+    ssize_t valread;
+    do {
+        valread = recvmsg( sock, &msg, flags );
+    } while ( valread < 0 and errno == EINTR );
+
+    if ( valread > 0 ) {
+        tail += valread;
+    }
+    return( valread );
+}
@@ -0,0 +1,62 @@
+#ifndef MPC_RINGBUFFER_H
+#define MPC_RINGBUFFER_H
+
+#include <string.h>     // memcpy
+#include <sys/types.h>  // ssize_t
+
+#include <vector>
+
+#include "MPC_Common.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Class RingBuffer
+// Receive buffer of a PeerConnection.  Bytes are read from the
+// socket into the free space at the tail and taken from the head,
+// so a message split over many recv() calls is reassembled in
+// place, and bytes of the next message read with it are kept for
+// the next call.
+//
+// The capacity is a power of two and is only grown when a single
+// message does not fit, after which it is kept for the life of the
+// connection.  A message that wraps past the end of the storage
+// is made contiguous by Contiguous(), which moves the bytes to the
+// start of the storage without allocating.
+//------------------------------------------------------------
+class RingBuffer {
+
+private:
+    vector< char > storage;
+    size_t mask;  // storage.size() - 1
+    uint64 head;  // Total bytes taken, storage index is head & mask
+    uint64 tail;  // Total bytes read in, storage index is tail & mask
+
+public:
+    RingBuffer( size_t capacity = RING_BUFFER_LENGTH );
+
+    size_t Size()     const { return (size_t)( tail - head ); }
+    size_t Capacity() const { return storage.size(); }
+    bool   Empty()    const { return head == tail; }
+
+    // Byte i of the buffered data, i < Size()
+    char At( size_t i ) const { return storage[ ( head + i ) & mask ]; }
+
+    // Copy the first count buffered bytes to p without taking them
+    void Peek( char *p, size_t count ) const;
+
+    // Pointer to the first count buffered bytes in one piece
+    const char *Contiguous( size_t count );
+
+    // Take count bytes from the head
+    void Consume( size_t count ) { head += count; }
+
+    // Grow so that count bytes fit, the buffered bytes are kept
+    void Reserve( size_t count );
+
+    // Read what the socket has, up to the free space.  Returns the
+    // recv() result: bytes read, 0 on close, -1 on error.
+    ssize_t Fill( int sock, int flags = 0 );
+};
+
+#endif
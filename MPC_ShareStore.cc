@@ -0,0 +1,74 @@
+#include "MPC_ShareStore.h"
+
+//------------------------------------------------------------
+// Returns secret v at each of the evaluatedX, in the order of
+// evaluatedX
+//------------------------------------------------------------
+vector< int64 > ShareInfo::Column( size_t v ) const {
+
+    if ( numSecrets == 1 ) {
+        return evaluatedF_x;
+    }
+
+    vector< int64 > column( evaluatedX.size() );
+    for ( size_t i = 0; i < evaluatedX.size(); i++ ) {
+        column[ i ] = evaluatedF_x[ i * numSecrets + v ];
+    }
+    return column;
+}
+
+//------------------------------------------------------------
+// Set the numSecrets values at x, replacing the row at x if
+// there is one.  Rows arrive sorted by x from DISTRIBUTE, and are
+// then appended.
+//------------------------------------------------------------
+void ShareInfo::SetPoint( int64 x_in, const int64 *values ) {
+
+    vector< int64 >::iterator xi =
+        lower_bound( evaluatedX.begin(), evaluatedX.end(), x_in );
+    size_t i = xi - evaluatedX.begin();
+
+    if ( xi == evaluatedX.end() or *xi != x_in ) {
+        evaluatedX.insert( xi, x_in );
+        evaluatedF_x.insert( evaluatedF_x.begin() + i * numSecrets,
+                             numSecrets, 0 );
+    }
+    copy( values, values + numSecrets,
+          evaluatedF_x.begin() + i * numSecrets );
+}
+
+//------------------------------------------------------------
+// Returns the index of shareID, or npos when it is not stored
+//------------------------------------------------------------
+size_t ShareStore::Find( const string &shareID ) const {
+
+    map< string, size_t >::const_iterator si = index.find( shareID );
+
+    return si == index.end() ? npos : si->second;
+}
+
+//------------------------------------------------------------
+// Returns the index of shareID, storing an empty ShareInfo for a
+// new shareID
+//------------------------------------------------------------
+size_t ShareStore::Intern( const string &shareID ) {
+
+    map< string, size_t >::iterator si = index.lower_bound( shareID );
+
+    if ( si != index.end() and si->first == shareID ) {
+        return si->second;
+    }
+
+    shares.push_back( ShareInfo( shareID ) );
+    index.insert( si, make_pair( shareID, shares.size() - 1 ) );
+
+    return shares.size() - 1;
+}
+
+//------------------------------------------------------------
+// Remove every share, the indices are given out again from 0
+//------------------------------------------------------------
+void ShareStore::Clear() {
+    shares.clear();
+    index.clear();
+}
@@ -0,0 +1,107 @@
+#ifndef MPC_SHARESTORE_H
+#define MPC_SHARESTORE_H
+
+#include <deque>
+
+#include "MPC_PeerCommon.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Container for remote Share information
+// Saved in the Peer CollectedShares store.
+//------------------------------------------------------------
+struct ShareInfo {
+    string shareID;
+    int64  prime;
+    int64  x;      // base of polynomial exponents
+    int64  f_x;    // evaluated value of polynomial using x
+
+    // The polynomial evaluated at the base exponent (x) of each
+    // Peer, in contiguous rows sorted by x:
+    //   evaluatedF_x[ i * numSecrets + v ] is secret v at evaluatedX[ i ]
+    // A vector share carries numSecrets values per x, secret 0 is
+    // the share of an ordinary or packed share.
+    vector< int64 > evaluatedX;
+    vector< int64 > evaluatedF_x;
+    size_t          numSecrets;
+
+    // Packed shares carry numPacked secrets in one polynomial,
+    // secret j is recovered at x = -j.  1 for an ordinary share.
+    size_t          numPacked;
+
+    // Coefficients of the polynomial, numCoef + numPacked - 1 for
+    // a packed share, so the fewest points that recover it.  0 when
+    // the sender did not say, e.g. a text SHAREVALUE.
+    size_t          numCoef;
+
+    // Sent by a DISTRIBUTE in direct mode, which gives each Peer
+    // only its own x.  f_x is not known and evaluatedX starts
+    // with the one value, the others are fetched with SHAREFETCH
+    // when the share is recovered.
+    bool            direct;
+
+    ShareInfo( string shareid = "", int64 prime = 0,
+               int64 x = 0, int64 f_x = 0 ) :
+        shareID( shareid ), prime( prime ), x( x ), f_x( f_x ),
+        numSecrets( 1 ), numPacked( 1 ), numCoef( 0 ), direct( false ) {}
+
+    size_t NumPoints() const { return evaluatedX.size(); }
+
+    // Points needed to recover the share.  Without numCoef, a
+    // packed share needs at least one point more than its secrets.
+    size_t PointsNeeded() const {
+        return numCoef ? numCoef : ( numPacked > 1 ? numPacked + 1 : 1 );
+    }
+
+    // Secret v evaluated at evaluatedX[ i ]
+    int64 F_x( size_t i, size_t v = 0 ) const {
+        return evaluatedF_x[ i * numSecrets + v ];
+    }
+
+    // The numSecrets values at evaluatedX[ i ]
+    const int64 *Row( size_t i ) const {
+        return evaluatedF_x.data() + i * numSecrets;
+    }
+
+    vector< int64 > Column( size_t v = 0 ) const;
+
+    void SetPoint( int64 x, const int64 *values );
+
+    // Keeps the capacity, so that the next update is in place
+    void ClearPoints() { evaluatedX.clear(); evaluatedF_x.clear(); }
+};
+
+//------------------------------------------------------------
+// Class ShareStore
+// The ShareInfo of every share a Peer has collected.  Share IDs
+// are interned to dense indices when first stored, and a ShareInfo
+// stays at its index, and its address, for the life of the store,
+// so a share is updated in place on every SHAREVALUE instead of
+// rebuilt.  Callers hold shareLock.
+//------------------------------------------------------------
+class ShareStore {
+
+private:
+    deque< ShareInfo >    shares; // [ index ] : ShareInfo
+    map< string, size_t > index;  // [ shareID ] : index
+
+public:
+    static const size_t npos = (size_t) -1;
+
+    size_t Size() const { return shares.size(); }
+
+    size_t Find( const string &shareID ) const;
+
+    size_t Intern( const string &shareID );
+
+    ShareInfo       &operator[]( size_t i )       { return shares[ i ]; }
+    const ShareInfo &operator[]( size_t i ) const { return shares[ i ]; }
+
+    // Share IDs in sorted order, [ shareID ] : index
+    const map< string, size_t > &Index() const { return index; }
+
+    void Clear();
+};
+
+#endif
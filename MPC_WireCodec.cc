@@ -0,0 +1,135 @@
+#include "MPC_WireCodec.h"
+
+//------------------------------------------------------------
+// Write header into the FRAME_HEADER_SIZE bytes at p
+//------------------------------------------------------------
+void EncodeHeader( char *p, const FrameHeader &header ) {
+    p[0] = (char)header.magic;
+    p[1] = (char)header.version;
+    StoreLE( p + 2, header.type,      2 );
+    StoreLE( p + 4, header.length,    4 );
+    StoreLE( p + 8, header.requestID, 8 );
+}
+
+//------------------------------------------------------------
+// Read header from the FRAME_HEADER_SIZE bytes at p.
+// Returns false if this is not a frame this version can read.
+//------------------------------------------------------------
+bool DecodeHeader( const char *p, FrameHeader &header ) {
+    header.magic     = (uint8)p[0];
+    header.version   = (uint8)p[1];
+    header.type      = (uint16)LoadLE( p + 2, 2 );
+    header.length    = (uint32)LoadLE( p + 4, 4 );
+    header.requestID = LoadLE( p + 8, 8 );
+
+    return( header.magic   == FRAME_MAGIC   and
+            header.version == FRAME_VERSION and
+            header.length  <= MAX_FRAME_LENGTH );
+}
+
+//------------------------------------------------------------
+//------------------------------------------------------------
+string FrameTypeName( uint16 type ) {
+    switch ( type ) {
+        case FRAME_TEXT:       return( "TEXT" );
+        case FRAME_END:        return( "END" );
+        case FRAME_SHAREVALUE: return( "SHAREVALUE" );
+        case FRAME_SHAREPOINT: return( "SHAREPOINT" );
+    }
+    return( "FRAME" + to_string( type ) );
+}
+
+//------------------------------------------------------------
+// Constructor
+// Leaves room for the header, reserve is the expected payload size
+//------------------------------------------------------------
+WireWriter::WireWriter( uint16 type, size_t reserve ) {
+    buffer.reserve( FRAME_HEADER_SIZE + reserve );
+    buffer.resize ( FRAME_HEADER_SIZE );
+    StoreLE( buffer.data() + 2, type, 2 );
+}
+
+//------------------------------------------------------------
+// Append count int64 values, a single copy on little-endian hosts
+//------------------------------------------------------------
+void WireWriter::PutInt64s( const int64 *v, size_t count ) {
+    size_t n = buffer.size();
+    buffer.resize( n + 8 * count );
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy( buffer.data() + n, v, 8 * count );
+#else
+    for ( size_t i = 0; i < count; i++ ) {
+        StoreLE( buffer.data() + n + 8 * i, (uint64)v[i], 8 );
+    }
+#endif
+}
+
+//------------------------------------------------------------
+// Append a string as a uint32 length and its bytes
+//------------------------------------------------------------
+void WireWriter::PutString( const string &s ) {
+    size_t n = buffer.size();
+    buffer.resize( n + 4 );
+    StoreLE( buffer.data() + n, (uint32)s.size(), 4 );
+    buffer.insert( buffer.end(), s.begin(), s.end() );
+}
+
+//------------------------------------------------------------
+// Fill in the header and return the whole frame
+//------------------------------------------------------------
+const char *WireWriter::Finish( uint64 requestID, size_t &size ) {
+    FrameHeader header;
+    header.magic     = FRAME_MAGIC;
+    header.version   = FRAME_VERSION;
+    header.type      = Type();
+    header.length    = (uint32)( buffer.size() - FRAME_HEADER_SIZE );
+    header.requestID = requestID;
+
+    EncodeHeader( buffer.data(), header );
+
+    size = buffer.size();
+    return buffer.data();
+}
+
+//------------------------------------------------------------
+// Read count int64 values into v, a single copy on little-endian
+// hosts.  Returns false, with v unchanged, if too few remain.
+//------------------------------------------------------------
+bool WireReader::GetInt64s( int64 *v, size_t count ) {
+    if ( count > ( size - pos ) / 8 ) {
+        ok  = false;
+        pos = size;
+        return false;
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy( v, data + pos, 8 * count );
+#else
+    for ( size_t i = 0; i < count; i++ ) {
+        v[i] = (int64)LoadLE( data + pos + 8 * i, 8 );
+    }
+#endif
+    pos += 8 * count;
+    return true;
+}
+
+//------------------------------------------------------------
+// Read a string written by WireWriter::PutString()
+//------------------------------------------------------------
+string WireReader::GetString() {
+    if ( size - pos < 4 ) {
+        ok  = false;
+        pos = size;
+        return string();
+    }
+    size_t length = (size_t)LoadLE( data + pos, 4 );
+    pos += 4;
+
+    if ( size - pos < length ) {
+        ok  = false;
+        pos = size;
+        return string();
+    }
+    string s( data + pos, length );
+    pos += length;
+    return s;
+}
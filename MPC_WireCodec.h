@@ -0,0 +1,149 @@
+#ifndef MPC_WIRECODEC_H
+#define MPC_WIRECODEC_H
+
+#include <string.h>  // memcpy
+
+#include <string>
+#include <vector>
+
+#include "MPC_Common.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Binary frames used between peers on pooled connections.
+//
+// Every frame is a 16 byte header and length bytes of payload:
+//   byte  0     FRAME_MAGIC, never the first byte of a telnet message
+//   byte  1     FRAME_VERSION
+//   bytes 2-3   type      uint16
+//   bytes 4-7   length    uint32, payload bytes after the header
+//   bytes 8-15  requestID uint64, 0 for a request that wants no reply
+// All integers are little-endian.  A reply frame carries the
+// requestID of its request, and FRAME_END ends the replies.
+//------------------------------------------------------------
+#define FRAME_MAGIC       0xA5
+#define FRAME_VERSION     1
+#define FRAME_HEADER_SIZE 16
+#define MAX_FRAME_LENGTH  ( 64 * 1024 * 1024 )
+
+typedef unsigned char  uint8;
+typedef unsigned short uint16;
+typedef unsigned int   uint32;
+
+enum FrameType {
+    FRAME_TEXT       = 1, // "msgType:msgData" message or reply
+    FRAME_END        = 2, // No more replies to requestID
+    FRAME_SHAREVALUE = 3, // SHAREVALUE in int64 fields, see MPC_Peer
+    FRAME_SHAREPOINT = 4  // One recipients share value, see MPC_Peer
+};
+
+struct FrameHeader {
+    uint8  magic;
+    uint8  version;
+    uint16 type;
+    uint32 length;
+    uint64 requestID;
+};
+
+//------------------------------------------------------------
+// Little-endian loads and stores at any alignment
+//------------------------------------------------------------
+inline void StoreLE( char *p, uint64 v, int bytes ) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy( p, &v, bytes );
+#else
+    for ( int i = 0; i < bytes; i++ ) { p[i] = (char)( v >> ( 8 * i ) ); }
+#endif
+}
+
+inline uint64 LoadLE( const char *p, int bytes ) {
+    uint64 v = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy( &v, p, bytes );
+#else
+    for ( int i = 0; i < bytes; i++ ) { v |= (uint64)(uint8)p[i] << ( 8 * i ); }
+#endif
+    return v;
+}
+
+// Header encode and decode, p points to FRAME_HEADER_SIZE bytes.
+// DecodeHeader returns false for a bad magic, version or length.
+void EncodeHeader( char *p, const FrameHeader &header );
+bool DecodeHeader( const char *p, FrameHeader &header );
+
+// Name of a FrameType, for log messages and STATS:
+string FrameTypeName( uint16 type );
+
+//------------------------------------------------------------
+// Class WireWriter
+// Builds one frame, header and payload, in a single buffer that
+// is handed to send() as is.  The header is filled in by Finish(),
+// so one encoded payload can be sent with different requestIDs.
+//------------------------------------------------------------
+class WireWriter {
+
+private:
+    vector< char > buffer;  // Header followed by payload
+
+public:
+    WireWriter( uint16 type, size_t reserve = 0 );
+
+    void PutInt64( int64 v ) {
+        size_t n = buffer.size();
+        buffer.resize( n + 8 );
+        StoreLE( buffer.data() + n, (uint64)v, 8 );
+    }
+
+    void PutInt64s( const int64 *v, size_t count );
+
+    void PutString( const string &s );
+
+    void PutBytes( const char *p, size_t count ) {
+        buffer.insert( buffer.end(), p, p + count );
+    }
+
+    // Writes the header for requestID, returns the frame to send
+    const char *Finish( uint64 requestID, size_t &size );
+
+    uint16 Type() const { return (uint16)LoadLE( buffer.data() + 2, 2 ); }
+};
+
+//------------------------------------------------------------
+// Class WireReader
+// Decodes a frame payload in place, nothing is copied until a
+// value is read.  Reading past the end sets Ok() false and
+// returns 0 or an empty string.
+//------------------------------------------------------------
+class WireReader {
+
+private:
+    const char *data;
+    size_t      size;
+    size_t      pos;
+    bool        ok;
+
+public:
+    WireReader( const char *data, size_t size ) :
+        data( data ), size( size ), pos( 0 ), ok( true ) {}
+
+    int64 GetInt64() {
+        if ( size - pos < 8 ) { ok = false; pos = size; return 0; }
+        int64 v = (int64)LoadLE( data + pos, 8 );
+        pos += 8;
+        return v;
+    }
+
+    bool GetInt64s( int64 *v, size_t count );
+
+    string GetString();
+
+    // The unread payload, e.g. the text of a FRAME_TEXT
+    string Rest() const { return string( data + pos, size - pos ); }
+
+    size_t Remaining() const { return size - pos; }
+
+    bool Ok() const { return ok; }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "MPC_WorkerPool.h"
+
+// The pool and queue index of the worker running on this thread,
+// NULL on threads that are not pool workers
+static thread_local WorkerPool *currentPool  = NULL;
+static thread_local size_t      currentIndex = 0;
+
+//------------------------------------------------------------
+// Constructor
+// Starts numThreads workers, at least one, with room for
+// maxQueued waiting tasks, at least one.
+//------------------------------------------------------------
+WorkerPool::WorkerPool( size_t numThreads, size_t _maxQueued ) :
+    maxQueued( _maxQueued ), queued( 0 ), available( 0 ), peakQueued( 0 ),
+    nextQueue( 0 ), submitted( 0 ), blocked( 0 ), ranInline( 0 ),
+    stopping( false ),
+    completed( 0 ), stolen( 0 )
+{
+    if ( numThreads < 1 ) {
+        numThreads = 1;
+    }
+    if ( maxQueued < 1 ) {
+        maxQueued = 1;
+    }
+
+    for ( size_t i = 0; i < numThreads; i++ ) {
+        queues.push_back( unique_ptr< WorkerQueue >( new WorkerQueue ) );
+    }
+    for ( size_t i = 0; i < numThreads; i++ ) {
+        workers.push_back( thread( &WorkerPool::WorkerLoop, this, i ) );
+    }
+}
+
+//------------------------------------------------------------
+// Destructor
+// Lets the workers finish the queued tasks, then joins them.
+//------------------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+    poolLock.lock();
+    stopping = true;
+    poolLock.unlock();
+
+    taskReady.notify_all();
+    spaceReady.notify_all();
+
+    for ( size_t i = 0; i < workers.size(); i++ ) {
+        workers[ i ].join();
+    }
+}
+
+//------------------------------------------------------------
+// Queue a task for a worker.  Blocks while maxQueued tasks are
+// waiting, or when called from a worker of this pool, runs the
+// task on the calling worker.
+//------------------------------------------------------------
+void WorkerPool::Submit( function< void() > task )
+{
+    bool   fromWorker = ( currentPool == this );
+    size_t index;
+    {
+        unique_lock< mutex > lock( poolLock );
+
+        if ( fromWorker and queued >= maxQueued and not stopping ) {
+            ranInline++;
+            submitted++;
+            lock.unlock();
+
+            RunTask( task );
+            return;
+        }
+        if ( not fromWorker and queued >= maxQueued and not stopping ) {
+            blocked++;
+            spaceReady.wait( lock, [ this ]() {
+                                       return stopping or queued < maxQueued;
+                                   } );
+        }
+
+        queued++;
+        submitted++;
+        peakQueued = max( peakQueued, queued );
+
+        index = fromWorker ? currentIndex : nextQueue++ % queues.size();
+    }
+
+    queues[ index ]->lock.lock();
+    queues[ index ]->tasks.push_back( move( task ) );
+    queues[ index ]->lock.unlock();
+
+    poolLock.lock();
+    available++;
+    poolLock.unlock();
+
+    taskReady.notify_one();
+}
+
+//------------------------------------------------------------
+// Take a task from the front of this worker's deque, or steal
+// one from the back of another worker's deque.
+// Returns false if every deque is empty.
+//------------------------------------------------------------
+bool WorkerPool::TakeTask( size_t index, function< void() > &task )
+{
+    for ( size_t i = 0; i < queues.size(); i++ ) {
+        size_t       q      = ( index + i ) % queues.size();
+        WorkerQueue *pQueue = queues[ q ].get();
+
+        lock_guard< mutex > lock( pQueue->lock );
+
+        if ( pQueue->tasks.empty() ) {
+            continue;
+        }
+        if ( q == index ) {
+            task = move( pQueue->tasks.front() );
+            pQueue->tasks.pop_front();
+        }
+        else {
+            task = move( pQueue->tasks.back() );
+            pQueue->tasks.pop_back();
+            stolen++;
+        }
+        return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------
+// Each worker claims one available task, takes it from its own
+// or another deque, and runs it outside every lock.  Returns
+// when the pool is stopping and no task is left.
+//------------------------------------------------------------
+void WorkerPool::WorkerLoop( size_t index )
+{
+    currentPool  = this;
+    currentIndex = index;
+
+    while ( true ) {
+        {
+            unique_lock< mutex > lock( poolLock );
+            taskReady.wait( lock, [ this ]() {
+                                      return stopping or available > 0;
+                                  } );
+
+            if ( available == 0 ) {
+                return; // stopping
+            }
+            available--;
+        }
+
+        // A claimed task is in some deque, but another worker may
+        // take it first and leave this worker's claim for a task
+        // that is still being pushed, so keep looking.
+        function< void() > task;
+        while ( not TakeTask( index, task ) ) {
+            this_thread::yield();
+        }
+
+        poolLock.lock();
+        queued--;
+        poolLock.unlock();
+        spaceReady.notify_one();
+
+        RunTask( task );
+    }
+}
+
+//------------------------------------------------------------
+// Run a task on this thread.  An exception thrown by the task,
+// e.g. a handler that failed to parse a request, is logged and
+// ends only that task, not the worker or the process.
+//------------------------------------------------------------
+void WorkerPool::RunTask( function< void() > &task )
+{
+    try {
+        task();
+    }
+    catch ( const exception &e ) {
+        ErrorMsg( string( "ERROR: WorkerPool task failed: " ) + e.what() );
+    }
+    catch ( ... ) {
+        ErrorMsg( "ERROR: WorkerPool task failed with an unknown exception" );
+    }
+
+    completed++;
+}
+
+//------------------------------------------------------------
+// Returns a snapshot of the pool counters
+//------------------------------------------------------------
+WorkerStats WorkerPool::Stats()
+{
+    lock_guard< mutex > lock( poolLock );
+
+    WorkerStats stats;
+    stats.numThreads = workers.size();
+    stats.maxQueued  = maxQueued;
+    stats.queued     = queued;
+    stats.peakQueued = peakQueued;
+    stats.submitted  = submitted;
+    stats.completed  = completed;
+    stats.stolen     = stolen;
+    stats.blocked    = blocked;
+    stats.ranInline  = ranInline;
+    return stats;
+}
@@ -0,0 +1,91 @@
+#ifndef MPC_WORKERPOOL_H
+#define MPC_WORKERPOOL_H
+
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+#include "MPC_PeerCommon.h"
+
+using namespace std;
+
+//------------------------------------------------------------
+// Snapshot of WorkerPool counters returned by WorkerPool::Stats()
+//------------------------------------------------------------
+struct WorkerStats {
+    size_t numThreads;
+    size_t maxQueued;   // Queue capacity before Submit() blocks
+    size_t queued;      // Tasks waiting for a worker
+    size_t peakQueued;  // Largest queued seen
+    uint64 submitted;
+    uint64 completed;
+    uint64 stolen;      // Tasks run by a worker other than their queue's
+    uint64 blocked;     // Submit() calls that waited for queue space
+    uint64 ranInline;   // Worker Submit() calls run at once, queue full
+};
+
+//------------------------------------------------------------
+// Fixed set of worker threads with a bounded, work-stealing queue.
+//
+// Every worker owns a deque.  Submit() from outside the pool
+// deals tasks round-robin over the deques, a task submitted by a
+// worker goes on its own deque.  A worker runs tasks from the front
+// of its own deque and, when that is empty, steals from the back of
+// the others, so one slow handler does not hold up the tasks queued
+// behind it.
+//
+// At most maxQueued tasks wait at once.  Submit() from outside the
+// pool blocks until a worker takes a task, which stops the caller
+// (the MainLoop reactor) from reading more requests and leaves them
+// in the kernel's socket queues.  Workers never block in Submit(),
+// which could leave every worker waiting for the others: a worker
+// that finds the queue full runs the task itself before it returns.
+//------------------------------------------------------------
+class WorkerPool {
+
+private:
+    struct WorkerQueue {
+        mutex                       lock;
+        deque< function< void() > > tasks;
+    };
+
+    vector< unique_ptr< WorkerQueue > > queues;  // One per worker
+    vector< thread >                    workers;
+
+    // Counts below are guarded by poolLock
+    mutex              poolLock;
+    condition_variable taskReady;   // Workers wait for available > 0
+    condition_variable spaceReady;  // Submit() waits for queued < maxQueued
+    size_t             maxQueued;
+    size_t             queued;      // Tasks reserved, not yet taken
+    size_t             available;   // Tasks pushed, not yet claimed
+    size_t             peakQueued;
+    size_t             nextQueue;   // Round-robin index for Submit()
+    uint64             submitted;
+    uint64             blocked;
+    uint64             ranInline;
+    bool               stopping;
+
+    atomic< uint64 >   completed;
+    atomic< uint64 >   stolen;
+
+    void WorkerLoop( size_t index );
+
+    bool TakeTask( size_t index, function< void() > &task );
+
+    void RunTask( function< void() > &task );
+
+public:
+    WorkerPool( size_t numThreads, size_t maxQueued );
+    ~WorkerPool();
+
+    void Submit( function< void() > task );
+
+    size_t NumThreads() const { return workers.size(); }
+
+    WorkerStats Stats();
+};
+
+#endif